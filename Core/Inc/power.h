@@ -10,6 +10,49 @@
 
 #include "main.h"
 
+// Подключается и из main.c (через pedal.hpp) — объявления только для C++
+#ifdef __cplusplus
+// Ступени энергосбережения, от лёгкой к глубокой:
+//  sleep         — WFI в главном цикле, будит любое прерывание (SOF, АЦП, педали)
+//  stop          — шина USB в suspend: STOP, пробуждение по педали (EXTI0..3),
+//                  resume хоста (EXTI18 OTG_FS_WKUP) или RTC; без переподключения
+//  stop_detached — таймаут простоя TIM2: tud_disconnect() + STOP, по педали
+//                  tud_connect() без сброса MCU
+//  STANDBY       — после PWR_STANDBY_AFTER_S в STOP без событий, как раньше
+enum class pwr_state : uint8_t {
+    sleep = 0, stop, stop_detached, count
+};
+
+struct pwr_wake_stats_t {
+    uint32_t count;               // пробуждений из этой ступени; sleep — только по нажатию
+    uint32_t resume_cycles_max;   // от выхода из WFI до готовности (PLL, USB), тактов DWT
+    uint32_t first_event_max;     // от пробуждения до первого MIDI/HID-сообщения, тиков TIM5 (100 мкс)
+};
+
+extern volatile pwr_wake_stats_t pwr_stats[static_cast<uint8_t>(pwr_state::count)];
+extern volatile int idle_timeout; // TIM2: простой
+
+// После пробуждения, прошедшего pwr_wake_qualify(): снимок из backup-регистров
 void pwr();
+void pwr_init();
+// Конец прохода главного цикла: выбрать ступень и заснуть, если работы нет.
+// work_pending — есть необработанные события педалей;
+// stop_blocked — идёт MIDI Clock или обмен по DIN: таймеры и USART1 нельзя
+// останавливать, ни таймаут простоя, ни suspend хоста не уводят в STOP (только WFI)
+void pwr_idle(bool (*work_pending)(), bool (*stop_blocked)());
+// Вызывается при отправке MIDI/HID: замер «пробуждение — первое событие»
+void pwr_note_event();
+void pwr_standby();
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+// Из main() до SystemClock_Config: проверить отсчётами АЦП, что пробуждение
+// из STANDBY вызвано педалью; иначе обратно в STANDBY, не возвращаясь
+void pwr_wake_qualify(void);
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* INC_POWER_H_ */
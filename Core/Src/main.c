@@ -69,7 +69,7 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
-
+  boot_profile_start();
   /* USER CODE END 1 */
 
   /* MCU Configuration--------------------------------------------------------*/
@@ -78,25 +78,28 @@ int main(void)
   HAL_Init();
 
   /* USER CODE BEGIN Init */
-
+  boot_mark(BOOT_STAGE_HAL);
+  pwr_wake_qualify();
+  boot_mark(BOOT_STAGE_WAKE);
   /* USER CODE END Init */
 
   /* Configure the system clock */
   SystemClock_Config();
 
   /* USER CODE BEGIN SysInit */
-
+  boot_mark(BOOT_STAGE_CLOCK);
   /* USER CODE END SysInit */
 
   /* Initialize all configured peripherals */
   MX_GPIO_Init();
-  MX_USB_OTG_FS_PCD_Init();
+  // MX_USB_OTG_FS_PCD_Init(); // OTG_FS поднимает TinyUSB (board_init_usb + tud_init), HAL PCD — минимум 10 мс HAL_Delay
   MX_TIM2_Init();
   MX_ADC1_Init();
   // MX_RTC_Init();
   MX_TIM3_Init();
   MX_TIM5_Init();
   /* USER CODE BEGIN 2 */
+  boot_mark(BOOT_STAGE_PERIPH);
   // bootloader
   #define BOOTLOADER_ADDRESS 0x1FFF0000 // 0x1FFF0000 ? (H7 - 0x1FF09800)
   typedef void (*pFunction)(void);
@@ -108,8 +111,7 @@ int main(void)
     JumpToApplication();
   }
   // bootloader
-  MX_RTC_Init();
-  pedal();
+  pedal(); // RTC — в pwr_init()
   /* USER CODE END 2 */
 
   /* Infinite loop */
@@ -56,6 +56,11 @@ void MX_RTC_Init(void)
   }
 
   /* USER CODE BEGIN Check_RTC_BKUP */
+  // Календарь уже идёт (выход из STANDBY): не входим в режим INIT ещё трижды
+  // (время, дата, wakeup) — таймер пробуждения всё равно выключает pwr_init()
+  if (RTC->ISR & RTC_ISR_INITS) {
+    return;
+  }
 
   /* USER CODE END Check_RTC_BKUP */
 
@@ -24,6 +24,7 @@
 /* USER CODE BEGIN Includes */
 #include "tusb.h"
 #include "tusb_config.h"
+#include "isr_profile.h"
 /* USER CODE END Includes */
 
 /* Private typedef -----------------------------------------------------------*/
@@ -43,6 +44,10 @@
 
 /* Private variables ---------------------------------------------------------*/
 /* USER CODE BEGIN PV */
+#if ISR_PROFILE
+volatile isr_cycles_t isr_cycles[ISR_ID_COUNT];
+volatile uint32_t isr_adc_trigger_us_max;
+#endif
 
 /* USER CODE END PV */
 
@@ -57,10 +62,7 @@
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
-extern ADC_HandleTypeDef hadc1;
 extern RTC_HandleTypeDef hrtc;
-extern TIM_HandleTypeDef htim2;
-extern TIM_HandleTypeDef htim3;
 extern PCD_HandleTypeDef hpcd_USB_OTG_FS;
 /* USER CODE BEGIN EV */
 
@@ -275,56 +277,6 @@ void EXTI3_IRQHandler(void)
   /* USER CODE END EXTI3_IRQn 1 */
 }
 #endif
-/**
-  * @brief This function handles ADC1 global interrupt.
-  */
-void ADC_IRQHandler(void)
-{
-  /* USER CODE BEGIN ADC_IRQn 0 */
-
-  /* USER CODE END ADC_IRQn 0 */
-  HAL_ADC_IRQHandler(&hadc1);
-  /* USER CODE BEGIN ADC_IRQn 1 */
-
-  /* USER CODE END ADC_IRQn 1 */
-}
-
-/**
-  * @brief This function handles TIM2 global interrupt.
-  */
-extern int pwr_flag;
-void TIM2_IRQHandler(void)
-{
-  /* USER CODE BEGIN TIM2_IRQn 0 */
-
-  /* USER CODE END TIM2_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim2);
-  /* USER CODE BEGIN TIM2_IRQn 1 */
-	if (pwr_flag) {
-    tud_disconnect();
-		HAL_PWR_DisableWakeUpPin(PWR_WAKEUP_PIN1);
-		__HAL_PWR_CLEAR_FLAG(PWR_FLAG_SB);
-		__HAL_PWR_CLEAR_FLAG(PWR_FLAG_WU);
-		HAL_PWR_EnableWakeUpPin(PWR_WAKEUP_PIN1);
-		HAL_PWR_EnterSTANDBYMode();
-	}
-  /* USER CODE END TIM2_IRQn 1 */
-}
-
-/**
-  * @brief This function handles TIM3 global interrupt.
-  */
-void TIM3_IRQHandler(void)
-{
-  /* USER CODE BEGIN TIM3_IRQn 0 */
-
-  /* USER CODE END TIM3_IRQn 0 */
-  HAL_TIM_IRQHandler(&htim3);
-  /* USER CODE BEGIN TIM3_IRQn 1 */
-
-  /* USER CODE END TIM3_IRQn 1 */
-}
-
 /**
   * @brief This function handles USB On The Go FS global interrupt.
   */
@@ -332,7 +284,9 @@ void OTG_FS_IRQHandler(void)
 {
   /* USER CODE BEGIN OTG_FS_IRQn 0 */
   // Обработчик прерываний TinyUSB для порта 0
+  ISR_PROFILE_ENTER();
   tud_int_handler(0);
+  ISR_PROFILE_EXIT(ISR_ID_USB);
   return;
   /* USER CODE END OTG_FS_IRQn 0 */
   HAL_PCD_IRQHandler(&hpcd_USB_OTG_FS);
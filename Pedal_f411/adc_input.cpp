@@ -0,0 +1,105 @@
+#include "adc_input.hpp"
+#include "tusb.h"
+#include "stm32f4xx.h"
+#include "power.h"
+#include "midi_out.hpp"
+
+static constexpr uint32_t ADC_RING_SIZE = 8u; // должно быть степенью 2; 64 мс отсчётов
+static_assert((ADC_RING_SIZE& (ADC_RING_SIZE - 1u)) == 0u, "ADC_RING_SIZE must be power of 2");
+
+static constexpr uint32_t  ADC_MIN = 300u; // подавление шума
+static constexpr uint32_t  ADC_MAX = 4095u; // 12 бит
+static constexpr uint32_t  ADC_HYSTERESIS = 14u; // +- гистерезис
+static constexpr uint8_t  MIDI_CC_SCALE = 30u;
+static constexpr uint8_t  MIDI_CC_OFFSET = 9u;
+static constexpr uint8_t  MIDI_CC_CHANNEL = 176u;   // 0xB0 — Control Change, канал 1
+static constexpr uint8_t  MIDI_CC_NUM = 64u;    // CC#64 — Sustain Pedal
+
+// SPSC-кольцо отсчётов: пишет только ADC ISR, читает только главный цикл.
+// Индексы свободно бегут по uint32_t, маска берётся при обращении к buf[].
+struct AdcRing {
+    uint16_t buf[ADC_RING_SIZE] = {};
+    uint32_t time[ADC_RING_SIZE] = {};  // TIM5 отсчёта — метка для MIDI_TIMESTAMPS
+    volatile uint32_t write_idx = 0u;
+    volatile uint32_t read_idx = 0u;
+    volatile uint32_t overruns = 0u;
+
+    void push(uint16_t sample) {
+        const uint32_t w = write_idx;
+        if (w - read_idx == ADC_RING_SIZE) {
+            overruns = overruns + 1u; // главный цикл завис — новый отсчёт теряется
+            return;
+        }
+        buf[w & (ADC_RING_SIZE - 1u)] = sample;
+        time[w & (ADC_RING_SIZE - 1u)] = TIM5->CNT;
+        __DMB(); // отсчёт записан до публикации индекса
+        write_idx = w + 1u;
+    }
+};
+
+static AdcRing ring;
+static uint32_t adc_prev = 0u;        // последнее принятое значение (для гистерезиса)
+static uint8_t  cc_velocity_prev = 0u;
+
+void adc_sample_isr(uint16_t raw) {
+    ring.push(raw);
+}
+
+void adc_process() {
+    const uint32_t w = ring.write_idx;
+    uint32_t r = ring.read_idx;
+    if (r == w) {
+        return;
+    }
+    __DMB(); // читаем buf[] только после индекса
+
+    // Пачка отсчётов, накопившихся с прошлого прохода, усредняется:
+    // обычно это один отсчёт, после долгого tud_task() — несколько
+    uint32_t sum = 0u;
+    const uint32_t n = w - r;
+    for (; r != w; ++r) {
+        sum += ring.buf[r & (ADC_RING_SIZE - 1u)];
+    }
+    const uint32_t time = ring.time[(w - 1u) & (ADC_RING_SIZE - 1u)]; // последний отсчёт пачки
+    __DMB();
+    ring.read_idx = w;
+
+    uint32_t adc_raw = sum / n;
+    if (adc_raw < ADC_MIN) {
+        adc_raw = ADC_MIN;
+    }
+    const uint32_t diff = adc_raw > adc_prev ? adc_raw - adc_prev : adc_prev - adc_raw;
+    if (diff <= ADC_HYSTERESIS) {
+        return;
+    }
+    adc_prev = adc_raw;
+
+    // MIDI 1.0 — только при смене 7-битного значения; UMP несёт 32 бита,
+    // поэтому уходит каждое изменение сверх гистерезиса
+    const uint8_t cc_velocity = adc_raw / MIDI_CC_SCALE - MIDI_CC_OFFSET;
+    if (cc_velocity != cc_velocity_prev || midi_ump_active()) {
+        const uint32_t cc32 = static_cast<uint32_t>(
+            (static_cast<uint64_t>(adc_raw - ADC_MIN) * 0xFFFFFFFFu) / (ADC_MAX - ADC_MIN));
+        midi_cc(midi_cable::sustain, MIDI_CC_CHANNEL, MIDI_CC_NUM, cc_velocity, cc32, time);
+        cc_velocity_prev = cc_velocity;
+        TIM2->CNT = 0; // активность — сброс таймаута простоя
+        pwr_note_event();
+    }
+}
+
+bool adc_pending() {
+    return ring.read_idx != ring.write_idx;
+}
+
+uint32_t adc_state_pack() {
+    return cc_velocity_prev | (adc_prev << 8);
+}
+
+void adc_state_unpack(uint32_t packed) {
+    cc_velocity_prev = static_cast<uint8_t>(packed & 0x7Fu);
+    adc_prev = (packed >> 8) & 0xFFFFu;
+}
+
+uint32_t adc_overruns() {
+    return ring.overruns;
+}
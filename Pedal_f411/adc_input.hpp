@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+// Педаль sustain (ADC1, запуск от TIM3 раз в 8 мс).
+// Прерывание только кладёт сырой отсчёт в кольцо; фильтрация, пересчёт в CC
+// и отправка MIDI выполняются пачкой в adc_process() из главного цикла.
+
+// Вызывается из ADC_IRQHandler: сохранить отсчёт. Несколько десятков тактов.
+void adc_sample_isr(uint16_t raw);
+
+// Главный цикл: разобрать накопленные отсчёты, при изменении отправить CC#64.
+void adc_process();
+
+// Есть необработанные отсчёты (проверка перед сном)
+bool adc_pending();
+
+// Состояние фильтра для снимка перед STANDBY (snapshot.cpp):
+// cc_velocity_prev [7:0], adc_prev [23:8]
+uint32_t adc_state_pack();
+void adc_state_unpack(uint32_t packed);
+
+// Отсчёты, потерянные из-за переполнения кольца (главный цикл не успевал)
+uint32_t adc_overruns();
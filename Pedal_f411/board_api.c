@@ -5,6 +5,7 @@
 
 #include "board_api.h"
 #include "stm32f4xx_hal.h"
+#include "irq_priority.h"
 #include <string.h>
 #include <stdio.h>
 
@@ -25,8 +26,7 @@ void board_init_usb(void) {
     // Включаем тактирование USB OTG FS
     __HAL_RCC_USB_OTG_FS_CLK_ENABLE();
     
-    // Настраиваем прерывание USB с приоритетом
-    HAL_NVIC_SetPriority(OTG_FS_IRQn, 6, 0);
+    // Приоритет уже выставлен irq_priority_apply() (IRQ_PRIO_USB)
     HAL_NVIC_EnableIRQ(OTG_FS_IRQn);
 }
 
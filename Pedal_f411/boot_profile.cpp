@@ -0,0 +1,77 @@
+#include "boot_profile.h"
+#include "tusb.h"
+#include "midi_out.hpp"
+
+#if BOOT_PROFILE
+
+static constexpr uint8_t SYSEX_ID_NONCOMMERCIAL = 0x7Du;
+static constexpr uint8_t SYSEX_BOOT_REPORT = 0x01u;
+static constexpr uint32_t SYSEX_US_MAX = 0x1FFFFFu; // 3 x 7 бит, ~2.1 с
+
+volatile uint32_t boot_us[BOOT_STAGE_COUNT];
+
+static uint32_t last_cycles = 0u;
+static uint32_t last_mhz = 16u; // до SystemClock_Config ядро на HSI
+static uint8_t report[4u + 3u * BOOT_STAGE_COUNT + 1u];
+static uint32_t report_len = 0u;   // 0 — сообщение ещё не собрано
+static uint32_t report_sent = 0u;
+
+void boot_profile_start() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    last_cycles = 0u;
+    last_mhz = SystemCoreClock / 1000000u;
+}
+
+// Повторная отметка стадии игнорируется: важен только первый проход.
+// CYCCNT на 96 МГц переполняется за ~44 с — для загрузки хватает с запасом
+void boot_mark(boot_stage_t stage) {
+    if (boot_us[stage] != 0u || stage == BOOT_STAGE_MAIN) {
+        return;
+    }
+    const uint32_t now = DWT->CYCCNT;
+    uint32_t prev_us = 0u;
+    for (uint32_t s = stage; s-- > 0u;) {
+        if (boot_us[s] != 0u) {
+            prev_us = boot_us[s];
+            break;
+        }
+    }
+    boot_us[stage] = prev_us + (now - last_cycles) / last_mhz;
+    last_cycles = now;
+    last_mhz = SystemCoreClock / 1000000u;
+}
+
+static void report_build() {
+    uint32_t n = 0u;
+    report[n++] = 0xF0u;
+    report[n++] = SYSEX_ID_NONCOMMERCIAL;
+    report[n++] = SYSEX_BOOT_REPORT;
+    report[n++] = BOOT_STAGE_COUNT;
+    for (uint32_t s = 0u; s < BOOT_STAGE_COUNT; ++s) {
+        const uint32_t us = boot_us[s] < SYSEX_US_MAX ? boot_us[s] : SYSEX_US_MAX;
+        report[n++] = us & 0x7Fu;
+        report[n++] = (us >> 7) & 0x7Fu;
+        report[n++] = (us >> 14) & 0x7Fu;
+    }
+    report[n++] = 0xF7u;
+    report_len = n;
+}
+
+// F0 7D 01 <число стадий> { мкс: 3 байта по 7 бит, младший первым } F7,
+// на кабеле диагностики. Не влезло в очередь кабеля — остаток дописывается на следующих проходах цикла
+// (midi_sysex продолжает незакрытый SysEx, в том числе в UMP)
+void boot_report() {
+    if (boot_us[BOOT_STAGE_FIRST_EVENT] == 0u || !tud_midi_mounted()) {
+        return;
+    }
+    if (report_len == 0u) {
+        report_build();
+    }
+    if (report_sent < report_len) {
+        report_sent += midi_sysex(midi_cable::diag, report + report_sent, report_len - report_sent);
+    }
+}
+
+#endif
@@ -0,0 +1,58 @@
+/*
+ * boot_profile.h
+ * Профиль холодной загрузки (выход из STANDBY = сброс) по DWT->CYCCNT:
+ * отметка в конце каждой стадии инициализации, от входа в main() до первого
+ * MIDI-сообщения, принятого стеком после подключения к хосту.
+ *
+ * Время каждой стадии пересчитывается в мкс по частоте ядра на её начало
+ * (до SystemClock_Config — HSI 16 МГц). Сброс и стартап до main() не видны.
+ * Результат — массив boot_us[] (Live Watch) и один SysEx после первого события.
+ */
+
+#ifndef BOOT_PROFILE_H_
+#define BOOT_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+// cmake -DBOOT_PROFILE=ON (или пресет Bench). Без опции отметки раскрываются в пустоту.
+#ifndef BOOT_PROFILE
+#define BOOT_PROFILE    0
+#endif
+
+typedef enum {
+    BOOT_STAGE_MAIN = 0,    // вход в main(), начало отсчёта
+    BOOT_STAGE_HAL,         // HAL_Init
+    BOOT_STAGE_WAKE,        // pwr_wake_qualify: серии отсчётов АЦП на HSI
+    BOOT_STAGE_CLOCK,       // SystemClock_Config: HSE + PLL
+    BOOT_STAGE_PERIPH,      // MX_xxx_Init (GPIO, таймеры, АЦП)
+    BOOT_STAGE_RTC,         // pwr_init, приоритеты прерываний, запуск АЦП, снимок (pwr)
+    BOOT_STAGE_USB,         // board_init_usb + tud_init: подтяжка D+ включена
+    BOOT_STAGE_MOUNTED,     // SET_CONFIGURATION от хоста
+    BOOT_STAGE_FIRST_EVENT, // первое сообщение после подключения
+    BOOT_STAGE_COUNT
+} boot_stage_t;
+
+// Нарастающим итогом от BOOT_STAGE_MAIN, мкс; 0 — стадия ещё не пройдена
+extern volatile uint32_t boot_us[BOOT_STAGE_COUNT];
+
+#if BOOT_PROFILE
+void boot_profile_start(void);
+void boot_mark(boot_stage_t stage);
+// Из главного цикла: отправить SysEx с boot_us[] один раз, после первого события
+void boot_report(void);
+#else
+static inline void boot_profile_start(void) {}
+static inline void boot_mark(boot_stage_t stage) { (void)stage; }
+static inline void boot_report(void) {}
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* BOOT_PROFILE_H_ */
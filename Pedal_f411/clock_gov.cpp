@@ -0,0 +1,117 @@
+#include "clock_gov.hpp"
+#include "main.h"
+#include "ll_periph.h"
+#include "diag_log.hpp"
+#include "trace.hpp"
+
+static constexpr uint32_t CLK_IDLE_HOLD_TICKS = 2000u; // 200 мс TIM5 без работы — вниз
+static constexpr uint32_t CLK_STAY_MAX_TICKS = 100000u; // 10 с: отрезок в журнал, такты в uint32 не переполнятся
+
+const clk_level_info clk_levels[static_cast<uint8_t>(clk_level::count)] = {
+    { 96000000u, RCC_SYSCLK_DIV1, FLASH_LATENCY_3, 0x6u, 220u, 90u },
+    { 24000000u, RCC_SYSCLK_DIV4, FLASH_LATENCY_0, 0x8u, 110u, 55u },
+};
+
+static_assert(ll::psc_at(ll::TIM5_CLOCK, 24000000u) == 2399u, "TIM5 at idle clock: 100 us tick");
+static_assert(ll::psc_at(ll::TIM3_ADC, 24000000u) == 23u, "TIM3 at idle clock: 1 us tick");
+static_assert(ll::psc_at(ll::TIM4_MIDI_CLOCK, 24000000u) == 23u, "TIM4 at idle clock: 1 us tick");
+static_assert(24000000u / ll::tick_hz(ll::TIM2_IDLE) * ll::tick_hz(ll::TIM2_IDLE) == 24000000u,
+    "TIM2 tick must divide the idle timer clock");
+
+volatile clk_stats_t clk_stats;
+
+static clk_level level = clk_level::active;
+static uint32_t last_busy = 0u;
+static uint32_t stay_start = 0u;    // TIM5: начало отрезка на текущем уровне
+static uint32_t stay_awake = 0u;    // такты вне WFI за отрезок
+
+// APB1 /2 на обоих уровнях: PCLK1 = 48 / 12 МГц, таймеры = 2 x PCLK1 = HCLK
+static uint32_t tim_clk_hz(clk_level l) {
+    return clk_levels[static_cast<uint8_t>(l)].hclk_hz;
+}
+
+// Время оборота USB зависит от HCLK: при понижении частоты TRDT увеличиваем до
+// переключения, при повышении — уменьшаем после (то же, что dwc2_phy_update() при tud_init)
+static void set_usb_trdt(uint32_t trdt) {
+    USB_OTG_FS->GUSBCFG = (USB_OTG_FS->GUSBCFG & ~USB_OTG_GUSBCFG_TRDT) | (trdt << USB_OTG_GUSBCFG_TRDT_Pos);
+}
+
+// Отрезок на текущем уровне — в clk_stats и журнал
+static void stay_close(uint32_t now) {
+    const uint8_t i = static_cast<uint8_t>(level);
+    const uint32_t ticks = now - stay_start;
+    const uint32_t awake_us = stay_awake / (clk_levels[i].hclk_hz / 1000000u);
+    clk_stats.ticks[i] = clk_stats.ticks[i] + ticks;
+    clk_stats.awake_ms[i] = clk_stats.awake_ms[i] + awake_us / 1000u;
+    LOG("clk: stay level %u, %u ticks, %u us awake", i, ticks, awake_us);
+    stay_start = now;
+    stay_awake = 0u;
+}
+
+static void apply(clk_level l) {
+    stay_close(TIM5->CNT);
+    const uint32_t t0 = DWT->CYCCNT;
+    const auto& info = clk_levels[static_cast<uint8_t>(l)];
+    const bool slower = info.hclk_hz < clk_levels[static_cast<uint8_t>(level)].hclk_hz;
+
+    if (slower) {
+        set_usb_trdt(info.usb_trdt);
+    }
+
+    RCC_ClkInitTypeDef clk = {};
+    clk.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
+    clk.AHBCLKDivider = info.ahb_div;
+    clk.APB1CLKDivider = RCC_HCLK_DIV2;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+    // HAL сам выбирает порядок: латентность flash до повышения частоты, после понижения;
+    // SystemCoreClock и SysTick (HAL_InitTick) обновляются там же
+    if (HAL_RCC_ClockConfig(&clk, info.flash_latency) != HAL_OK) {
+        Error_Handler();
+    }
+    ll::retime(tim_clk_hz(l));
+    if (!slower) {
+        set_usb_trdt(info.usb_trdt);
+    }
+    level = l;
+
+    const uint32_t dt = DWT->CYCCNT - t0;
+    clk_stats.switches[static_cast<uint8_t>(l)] = clk_stats.switches[static_cast<uint8_t>(l)] + 1u;
+    if (dt > clk_stats.switch_cycles_max) {
+        clk_stats.switch_cycles_max = dt;
+    }
+    LOG("clk: level %u, switch %u cycles", static_cast<uint32_t>(l), dt);
+    TRACE("clk: hclk %u Hz from here on", info.hclk_hz); // CYCCNT меняет темп — для пересчёта меток
+}
+
+void clk_governor(bool busy) {
+    const uint32_t now = TIM5->CNT;
+    if (busy) {
+        last_busy = now;
+        if (level != clk_level::active) {
+            apply(clk_level::active);
+        }
+    } else if (level == clk_level::active && now - last_busy > CLK_IDLE_HOLD_TICKS) {
+        apply(clk_level::idle);
+    }
+    if (now - stay_start >= CLK_STAY_MAX_TICKS) {
+        stay_close(now);
+    }
+}
+
+void clk_awake(uint32_t cycles) {
+    stay_awake += cycles;
+}
+
+void clk_resync() {
+    stay_close(TIM5->CNT); // TIM5 стоял в STOP: отрезок — только время до сна
+    if (level != clk_level::active) {
+        ll::retime(tim_clk_hz(clk_level::active));
+        set_usb_trdt(clk_levels[static_cast<uint8_t>(clk_level::active)].usb_trdt);
+        level = clk_level::active;
+    }
+    last_busy = TIM5->CNT;
+}
+
+clk_level clk_current() {
+    return level;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+// Регулятор частоты: PLL не трогаем (PLLQ даёт USB 48 МГц), меняется только
+// делитель AHB. Таймеры TIM2/3/4/5 и BRR USART1 пересчитываются (ll::retime), тики не плывут.
+//   active — SYSCLK 96 МГц, HCLK 96 МГц: события педалей, всплески АЦП, USB-трафик
+//   idle   — SYSCLK 96 МГц, HCLK 24 МГц (AHB /4): OTG_FS требует HCLK >= 14.2 МГц
+enum class clk_level : uint8_t {
+    active = 0, idle, count
+};
+
+struct clk_level_info {
+    uint32_t hclk_hz;
+    uint32_t ahb_div;           // RCC_SYSCLK_DIVx
+    uint32_t flash_latency;     // FLASH_LATENCY_x для 3.3 В
+    uint32_t usb_trdt;          // GUSBCFG.TRDT по таблице RM0383 для этой HCLK
+    uint16_t run_ma_x10;        // оценка тока в работе, 0.1 мА (даташит, типовые, периферия вкл.), не замер
+    uint16_t sleep_ma_x10;      // оценка тока в WFI, 0.1 мА, не замер
+};
+
+extern const clk_level_info clk_levels[static_cast<uint8_t>(clk_level::count)];
+
+// Замер, а не оценка: время на уровне (TIM5; в STOP таймер стоит) и из него — вне WFI
+// (DWT между выходом из WFI и следующим входом). Каждый отрезок на уровне, но не
+// длиннее 10 с, ещё и строка LOG "clk: stay ..." — из них tools/clk_table.py строит
+// таблицу загрузки по уровням
+struct clk_stats_t {
+    uint32_t switches[static_cast<uint8_t>(clk_level::count)]; // переходов в уровень
+    uint32_t switch_cycles_max;                                // худший переход, тактов DWT
+    uint32_t ticks[static_cast<uint8_t>(clk_level::count)];    // на уровне, тики TIM5
+    uint32_t awake_ms[static_cast<uint8_t>(clk_level::count)]; // из них вне WFI, мс
+};
+
+extern volatile clk_stats_t clk_stats;
+
+// Проход главного цикла: busy — есть работа (педали, сообщения, пачка АЦП).
+// Вверх — сразу, вниз — после CLK_IDLE_HOLD_TICKS без работы.
+void clk_governor(bool busy);
+
+// После SystemClock_Config() (выход из STOP): уровень снова active, таймеры под 96 МГц
+void clk_resync();
+
+clk_level clk_current();
+
+// Из pwr_idle() перед WFI / STOP: такты DWT вне сна с прошлого выхода из него
+void clk_awake(uint32_t cycles);
@@ -0,0 +1,27 @@
+#include "diag_log.hpp"
+#include "tusb.h"
+
+rec_ring<LOG_RING_WORDS, REC_LOST_LOG> diag_log_ring;
+
+#if DIAG_LOG
+
+static uint32_t dropped_reported = 0u;
+
+void diag_log_process() {
+    tud_cdc_read_flush(); // консоль только выводит
+    if (!tud_cdc_connected()) {
+        return;
+    }
+    uint32_t rec[REC_WORDS_MAX];
+    uint32_t n;
+    bool wrote = false;
+    while (tud_cdc_write_available() >= sizeof(rec) && diag_log_ring.next(dropped_reported, TIM5->CNT, rec, n)) {
+        tud_cdc_write(rec, n * sizeof(uint32_t));
+        wrote = true;
+    }
+    if (wrote) {
+        tud_cdc_write_flush();
+    }
+}
+
+#endif
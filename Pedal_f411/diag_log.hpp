@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include "usb_profile.h" // USB_CDC_CONSOLE
+#include "rec_ring.hpp"
+
+// Двоичный журнал с отложенным форматированием. Вызов LOG("fmt", args...) кладёт
+// в кольцо только id строки формата и до LOG_ARGS_MAX целых аргументов. Сама строка
+// лежит в секции .log_strings: она не загружается в прошивку (INFO в STM32F411XX_FLASH.ld)
+// и есть только в ELF. id строки — её адрес в этой секции. Текст собирает хост:
+// tools/diag_log.py читает таблицу строк из ELF.
+//
+// Запись в кольцо не блокируется и безопасна из любого прерывания (rec_ring.hpp);
+// метка времени — TIM5, 100 мкс.
+//
+// Слив — diag_log_process() из главного цикла в CDC-консоль, пока на хосте открыт порт (DTR).
+// Без открытого порта записи копятся с загрузки, пока не заполнят кольцо.
+// Спецификаторы формата — только целые: %u %d %x %X %c (и ширина: %08x).
+
+#ifndef DIAG_LOG
+#define DIAG_LOG        USB_CDC_CONSOLE
+#endif
+
+static constexpr uint32_t LOG_ARGS_MAX = REC_ARGS_MAX;
+static constexpr uint32_t LOG_RING_WORDS = 256u;    // 1 КБ, ~40 записей
+
+extern rec_ring<LOG_RING_WORDS, REC_LOST_LOG> diag_log_ring;
+
+#if DIAG_LOG
+// Строки формата нельзя писать из inline-функций и шаблонов: static из COMDAT
+// с атрибутом section даёт конфликт типов секций
+#define LOG_ID(fmt) ({ \
+    static const char log_fmt_[] __attribute__((section(".log_strings"), used)) = fmt; \
+    reinterpret_cast<uint32_t>(log_fmt_); })
+
+#define LOG(fmt, ...) diag_log_emit(LOG_ID(fmt), ##__VA_ARGS__)
+
+template <typename... A>
+inline void diag_log_emit(uint32_t id, A... a) {
+    static_assert(sizeof...(A) <= LOG_ARGS_MAX, "too many LOG arguments");
+    const uint32_t args[] = { static_cast<uint32_t>(a)..., 0u };
+    diag_log_ring.put(id, TIM5->CNT, args, sizeof...(A));
+}
+
+// Из главного цикла: готовые записи -> CDC
+void diag_log_process();
+#else
+#define LOG(fmt, ...) do {} while (0)
+inline void diag_log_process() {}
+#endif
@@ -0,0 +1,133 @@
+#include "hid_reports.hpp"
+#include "tusb.h"
+#include <string.h>
+
+#if USB_HID
+
+static constexpr uint32_t HID_QUEUE_SIZE = 4u; // должно быть степенью 2
+static_assert((HID_QUEUE_SIZE& (HID_QUEUE_SIZE - 1u)) == 0u, "HID_QUEUE_SIZE must be power of 2");
+static constexpr uint8_t HID_REPORT_MAX = 8u;   // hid_keyboard_report_t — самый длинный отчёт
+static_assert(HID_REPORT_MAX + 1u <= CFG_TUD_HID_EP_BUFSIZE, "HID EP buffer must hold report + ID");
+
+struct HidReport {
+    uint8_t data[HID_REPORT_MAX] = {};
+    uint8_t len = 0u;
+};
+
+// Очередь одного Report ID. Пишет и читает только main loop (tud_task),
+// поэтому барьеры не нужны.
+struct HidQueue {
+    HidReport buf[HID_QUEUE_SIZE] = {};
+    uint32_t write_idx = 0u;
+    uint32_t read_idx = 0u;
+
+    bool empty() const { return read_idx == write_idx; }
+    bool full() const { return write_idx - read_idx == HID_QUEUE_SIZE; }
+    HidReport& front() { return buf[read_idx & (HID_QUEUE_SIZE - 1u)]; }
+    void pop_front() { ++read_idx; }
+
+    bool push(const void* report, uint8_t len) {
+        if (full() || len > HID_REPORT_MAX) {
+            return false;
+        }
+        auto& r = buf[write_idx & (HID_QUEUE_SIZE - 1u)];
+        memcpy(r.data, report, len);
+        r.len = len;
+        ++write_idx;
+        return true;
+    }
+};
+
+static HidQueue queues[REPORT_ID_COUNT]; // индекс 0 не используется
+static uint8_t rr_next = REPORT_ID_CONSUMER_CONTROL; // round-robin для не-клавиатурных ID
+
+bool hid_submit(uint8_t report_id, const void* report, uint8_t len) {
+    if (report_id == 0u || report_id >= REPORT_ID_COUNT) {
+        return false;
+    }
+    const bool ok = queues[report_id].push(report, len);
+#if !USB_TX_SOF_SYNC
+    hid_dispatch();
+#endif
+    return ok;
+}
+
+static bool send_front(uint8_t report_id) {
+    auto& q = queues[report_id];
+    if (q.empty()) {
+        return false;
+    }
+    auto& r = q.front();
+    if (tud_hid_report(report_id, r.data, r.len)) {
+        q.pop_front();
+    }
+    return true; // endpoint занят в любом случае — дальше не пробуем
+}
+
+void hid_dispatch() {
+    if (!tud_hid_ready()) {
+        return;
+    }
+    // Клавиатура — приоритетно: нажатие стрелок не ждёт медиа-клавиш.
+    if (send_front(REPORT_ID_KEYBOARD)) {
+        return;
+    }
+    for (uint8_t i = REPORT_ID_CONSUMER_CONTROL; i < REPORT_ID_COUNT; ++i) {
+        const uint8_t id = rr_next;
+        rr_next = (rr_next + 1u < REPORT_ID_COUNT) ? rr_next + 1u : REPORT_ID_CONSUMER_CONTROL;
+        if (send_front(id)) {
+            return;
+        }
+    }
+}
+
+bool hid_keyboard_press(uint8_t keycode) {
+    hid_keyboard_report_t report = {};
+    report.keycode[0] = keycode;
+    return hid_submit(REPORT_ID_KEYBOARD, &report, sizeof(report));
+}
+
+bool hid_keyboard_release() {
+    hid_keyboard_report_t report = {};
+    return hid_submit(REPORT_ID_KEYBOARD, &report, sizeof(report));
+}
+
+bool hid_consumer_press(uint16_t usage) {
+    return hid_submit(REPORT_ID_CONSUMER_CONTROL, &usage, sizeof(usage));
+}
+
+bool hid_consumer_release() {
+    uint16_t usage = 0u;
+    return hid_submit(REPORT_ID_CONSUMER_CONTROL, &usage, sizeof(usage));
+}
+
+bool hid_system_press(uint8_t code) {
+    return hid_submit(REPORT_ID_SYSTEM_CONTROL, &code, sizeof(code));
+}
+
+bool hid_system_release() {
+    uint8_t code = 0u;
+    return hid_submit(REPORT_ID_SYSTEM_CONTROL, &code, sizeof(code));
+}
+
+extern "C" {
+    // Endpoint освободился — сразу отправляем следующий отчёт из очередей
+    void tud_hid_report_complete_cb(uint8_t instance, uint8_t const* report, uint16_t len) {
+        (void)instance;
+        (void)report;
+        (void)len;
+#if !USB_TX_SOF_SYNC
+        hid_dispatch();
+#endif
+    }
+
+#if USB_TX_SOF_SYNC
+    // Один отчёт за кадр, в начале кадра — до следующего IN-токена хоста
+    void tud_sof_cb(uint32_t frame_count) {
+        (void)frame_count;
+        hid_dispatch();
+    }
+#endif
+}
+
+#endif
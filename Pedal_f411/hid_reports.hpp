@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "usb_descriptors.h"
+#include "usb_profile.h" // USB_HID
+
+// Диспетчер составных HID-отчётов: клавиатура, Consumer Control, System Control.
+// Каждый Report ID имеет свою маленькую очередь, отчёты уходят в общий HID endpoint
+// по одному за транзакцию. Клавиатура всегда обслуживается первой.
+
+// В сборке с USB_CDC_CONSOLE интерфейса HID нет: функции — пустышки, отчёты не уходят.
+
+#if USB_HID
+// Поставить отчёт в очередь. false — очередь этого Report ID заполнена.
+bool hid_submit(uint8_t report_id, const void* report, uint8_t len);
+
+// Отправить следующий отчёт, если endpoint свободен. Вызывается из main loop
+// и из tud_hid_report_complete_cb, а при USB_TX_SOF_SYNC — только из tud_sof_cb.
+void hid_dispatch();
+
+bool hid_keyboard_press(uint8_t keycode);
+bool hid_keyboard_release();
+bool hid_consumer_press(uint16_t usage);  // HID_USAGE_CONSUMER_*
+bool hid_consumer_release();
+bool hid_system_press(uint8_t code);      // 1 - power off, 2 - sleep, 3 - wake host
+bool hid_system_release();
+#else
+#include "class/hid/hid.h" // HID_USAGE_CONSUMER_* для вызывающих
+inline bool hid_submit(uint8_t report_id, const void* report, uint8_t len) { (void)report_id; (void)report; (void)len; return false; }
+inline void hid_dispatch() {}
+inline bool hid_keyboard_press(uint8_t keycode) { (void)keycode; return false; }
+inline bool hid_keyboard_release() { return false; }
+inline bool hid_consumer_press(uint16_t usage) { (void)usage; return false; }
+inline bool hid_consumer_release() { return false; }
+inline bool hid_system_press(uint8_t code) { (void)code; return false; }
+inline bool hid_system_release() { return false; }
+#endif
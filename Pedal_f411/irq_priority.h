@@ -0,0 +1,57 @@
+/*
+ * irq_priority.h
+ * Схема приоритетов прерываний (NVIC_PRIORITYGROUP_4, меньше — важнее).
+ *
+ * Правило: обработчики только снимают метку времени / отсчёт и кладут его
+ * в очередь (RingBuf педалей, почтовый ящик АЦП, флаг таймаута). Весь
+ * обмен с TinyUSB (tud_midi_*, tud_hid_*, tud_disconnect) идёт из главного
+ * цикла, поэтому прерывания не ждут USB. Исключение — 0xF8 из TIM4: только
+ * запись в tx_ff (tud_midi_n_write_isr), без endpoint'а; единственный другой
+ * писатель tx_ff, главный цикл, на это время уступает (midi_out.cpp).
+ * OTG_FS — самый низкий приоритет: драйвер DWC2 не задерживает метки педалей.
+ *
+ * Приоритеты в Core/Src (CubeMX) перезаписываются irq_priority_apply(),
+ * чтобы перегенерация .ioc не ломала схему. Вся карта — только здесь:
+ * остальной код прерывания лишь разрешает.
+ */
+
+#ifndef IRQ_PRIORITY_H_
+#define IRQ_PRIORITY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "stm32f4xx_hal.h"
+
+#define IRQ_PRIO_CLOCK      0   // TIM4 — тик MIDI Clock (midi_clock.cpp), джиттер 0xF8
+#define IRQ_PRIO_EXTI       1   // метка TIM5 нажатия педали, джиттер виден сразу
+#define IRQ_PRIO_ADC        2   // отсчёт раз в 8 мс, запас по времени большой
+#define IRQ_PRIO_TIM        3   // TIM2 — таймаут простоя, TIM3 — триггер АЦП
+#define IRQ_PRIO_DMA        4   // DMA2 Stream7/2, USART1 — MIDI DIN: конец блока, кольцо приёма, IDLE; только будят цикл
+#define IRQ_PRIO_RTC        5
+#define IRQ_PRIO_USB        6   // OTG_FS: TinyUSB DCD
+
+static inline void irq_priority_apply(void) {
+    HAL_NVIC_SetPriority(TIM4_IRQn, IRQ_PRIO_CLOCK, 0);
+    HAL_NVIC_SetPriority(EXTI0_IRQn, IRQ_PRIO_EXTI, 0);
+    HAL_NVIC_SetPriority(EXTI1_IRQn, IRQ_PRIO_EXTI, 0);
+    HAL_NVIC_SetPriority(EXTI2_IRQn, IRQ_PRIO_EXTI, 0);
+    HAL_NVIC_SetPriority(EXTI3_IRQn, IRQ_PRIO_EXTI, 0);
+    HAL_NVIC_SetPriority(ADC_IRQn, IRQ_PRIO_ADC, 0);
+    HAL_NVIC_SetPriority(TIM2_IRQn, IRQ_PRIO_TIM, 0);
+    HAL_NVIC_SetPriority(TIM3_IRQn, IRQ_PRIO_TIM, 0);
+    HAL_NVIC_SetPriority(DMA2_Stream7_IRQn, IRQ_PRIO_DMA, 0);
+    HAL_NVIC_SetPriority(DMA2_Stream2_IRQn, IRQ_PRIO_DMA, 0);
+    HAL_NVIC_SetPriority(USART1_IRQn, IRQ_PRIO_DMA, 0);
+    HAL_NVIC_SetPriority(EXTI15_10_IRQn, IRQ_PRIO_DMA, 0);  // PA10 будит STOP (MIDI_DIN)
+    HAL_NVIC_SetPriority(RTC_WKUP_IRQn, IRQ_PRIO_RTC, 0);
+    HAL_NVIC_SetPriority(OTG_FS_IRQn, IRQ_PRIO_USB, 0);
+    HAL_NVIC_SetPriority(OTG_FS_WKUP_IRQn, IRQ_PRIO_USB, 0);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* IRQ_PRIORITY_H_ */
@@ -0,0 +1,124 @@
+/*
+ * isr_profile.h
+ * Замер времени в обработчиках прерываний по счётчику тактов DWT->CYCCNT
+ * (1 такт = 1/96 МГц). Результаты лежат в глобальном массиве isr_cycles[]
+ * и читаются отладчиком (Live Watch) без остановки ядра.
+ *
+ * Время считается от входа в обработчик до выхода, вместе с вытеснением
+ * более приоритетными прерываниями, т.е. это время отклика данного IRQ.
+ * Превышение бюджета (ISR_BUDGET_*) считается в поле over: после изменений
+ * достаточно прогнать сборку Bench и убедиться, что over == 0.
+ */
+
+#ifndef ISR_PROFILE_H_
+#define ISR_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+// cmake -DISR_PROFILE=ON (или пресет Bench). Без опции замеры не компилируются вовсе.
+#ifndef ISR_PROFILE
+#define ISR_PROFILE     0
+#endif
+
+typedef enum {
+    ISR_ID_EXTI = 0,    // EXTI0..3, педали
+    ISR_ID_ADC,         // ADC1, педаль sustain
+    ISR_ID_TIM2,        // таймаут простоя
+    ISR_ID_USB,         // OTG_FS, tud_int_handler целиком
+    ISR_ID_CLOCK,       // TIM4, тик MIDI Clock
+    ISR_ID_COUNT
+} isr_id_t;
+
+// Бюджеты, тактов. Регрессия — любое ненулевое isr_cycles[id].over
+#define ISR_BUDGET_EXTI     150u
+#define ISR_BUDGET_ADC      400u
+#define ISR_BUDGET_TIM2     300u
+#define ISR_BUDGET_USB      4000u
+#define ISR_BUDGET_CLOCK    150u
+
+typedef struct {
+    uint32_t count;     // число входов в обработчик
+    uint32_t last;      // последний замер, тактов
+    uint32_t max;       // худший случай, тактов
+    uint32_t over;      // замеров сверх бюджета
+    uint64_t total;     // сумма для среднего: total / count
+} isr_cycles_t;
+
+extern volatile isr_cycles_t isr_cycles[ISR_ID_COUNT];
+
+// Задержка запуска ADC_IRQHandler от TRGO TIM3 (вместе с преобразованием), мкс
+extern volatile uint32_t isr_adc_trigger_us_max;
+
+// CYCCNT не обнуляется: замеры — разности, а с BOOT_PROFILE счёт идёт от main()
+static inline void isr_profile_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t isr_cycles_now(void) {
+    return DWT->CYCCNT;
+}
+
+static inline uint32_t isr_budget(isr_id_t id) {
+    static const uint32_t budget[ISR_ID_COUNT] = {
+        ISR_BUDGET_EXTI, ISR_BUDGET_ADC, ISR_BUDGET_TIM2, ISR_BUDGET_USB, ISR_BUDGET_CLOCK
+    };
+    return budget[id];
+}
+
+// Вызывается в конце обработчика с отметкой, снятой на входе
+static inline void isr_cycles_add(isr_id_t id, uint32_t start) {
+    const uint32_t dt = DWT->CYCCNT - start;
+    volatile isr_cycles_t* s = &isr_cycles[id];
+    s->count++;
+    s->last = dt;
+    s->total += dt;
+    if (dt > s->max) {
+        s->max = dt;
+    }
+    if (dt > isr_budget(id)) {
+        s->over++;
+    }
+}
+
+// Вход в ADC_IRQHandler: TIM3 считает 1 МГц и обнуляется по TRGO,
+// поэтому CNT = мкс от запуска преобразования
+static inline void isr_adc_trigger_mark(void) {
+#if ISR_PROFILE
+    const uint32_t trigger_us = TIM3->CNT;
+    if (trigger_us > isr_adc_trigger_us_max) {
+        isr_adc_trigger_us_max = trigger_us;
+    }
+#endif
+}
+
+static inline void isr_cycles_reset(void) {
+    for (uint32_t i = 0; i < ISR_ID_COUNT; i++) {
+        isr_cycles[i].count = 0;
+        isr_cycles[i].last = 0;
+        isr_cycles[i].max = 0;
+        isr_cycles[i].over = 0;
+        isr_cycles[i].total = 0;
+    }
+    isr_adc_trigger_us_max = 0;
+}
+
+// Обёртки для обработчиков: без ISR_PROFILE раскрываются в пустоту
+#if ISR_PROFILE
+#define ISR_PROFILE_ENTER()     const uint32_t isr_t0_ = isr_cycles_now()
+#define ISR_PROFILE_EXIT(id)    isr_cycles_add((id), isr_t0_)
+#else
+#define ISR_PROFILE_ENTER()     do {} while (0)
+#define ISR_PROFILE_EXIT(id)    do {} while (0)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ISR_PROFILE_H_ */
@@ -0,0 +1,140 @@
+#include "ll_periph.h"
+#include "main.h"
+#include "adc.h"
+#include "tim.h"
+#include "adc_input.hpp"
+#include "isr_profile.h"
+#include "midi_clock.hpp"
+#include "midi_din.hpp"
+#include "trace.hpp"
+
+extern volatile int pwr_flag;
+extern volatile int idle_timeout;
+
+namespace ll {
+
+static bool tim_matches(const TIM_TypeDef* tim, const TimCfg& cfg) {
+    return tim->PSC == cfg.psc && tim->ARR == cfg.arr;
+}
+
+void check_config() {
+    if (!tim_matches(TIM2, TIM2_IDLE) || !tim_matches(TIM3, TIM3_ADC) || !tim_matches(TIM5, TIM5_CLOCK)) {
+        Error_Handler();
+    }
+}
+
+void adc_burst(uint16_t* buf, uint32_t n) {
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOBEN;
+    RCC->APB2ENR |= RCC_APB2ENR_ADC1EN;
+    (void)RCC->APB2ENR;                             // такт шины после включения
+    GPIOB->MODER |= GPIO_MODER_MODER0;              // PB0 — аналоговый вход
+    ADC1->SMPR2 = (ADC1->SMPR2 & ~ADC_SMPR2_SMP8) | ADC_SMPR2_SMP8_1; // 28 тактов
+    ADC1->SQR1 = 0u;                                // одно преобразование в последовательности
+    ADC1->SQR3 = 8u << ADC_SQR3_SQ1_Pos;            // канал 8
+    ADC1->CR2 = ADC_CR2_ADON;
+    for (uint32_t wait = ADC_STAB_DELAY_US * (SystemCoreClock / 1000000u); wait != 0u; --wait) {
+        __NOP();
+    }
+    for (uint32_t i = 0u; i < n; ++i) {
+        ADC1->CR2 |= ADC_CR2_SWSTART;
+        while (!(ADC1->SR & ADC_SR_EOC)) {
+        }
+        buf[i] = static_cast<uint16_t>(ADC1->DR);   // чтение DR снимает EOC
+    }
+    ADC1->CR2 = 0u; // дальше АЦП настраивает MX_ADC1_Init
+}
+
+// PSC буферизован и применяется по событию обновления. UG даёт его сразу, но
+// обнуляет счётчик — CNT сохраняем; URS = 1, чтобы UG не поднял UIF (TIM2 = таймаут)
+static void set_psc(TIM_TypeDef* tim, uint32_t psc) {
+    tim->CR1 |= TIM_CR1_URS;
+    const uint32_t cnt = tim->CNT;
+    tim->PSC = psc;
+    tim->EGR = TIM_EGR_UG;
+    tim->CNT = cnt;
+    tim->CR1 &= ~TIM_CR1_URS;
+}
+
+void retime(uint32_t tim_clk_hz) {
+    __disable_irq();
+    set_psc(TIM5, psc_at(TIM5_CLOCK, tim_clk_hz));
+    // TRGO TIM3 — Update, а URS маскирует только прерывание: UG запустил бы лишнее
+    // преобразование АЦП. Внешний запуск АЦП на время UG снят
+    const uint32_t exten = ADC1->CR2 & ADC_CR2_EXTEN;
+    ADC1->CR2 &= ~ADC_CR2_EXTEN;
+    set_psc(TIM3, psc_at(TIM3_ADC, tim_clk_hz));
+    ADC1->CR2 |= exten;
+    set_psc(TIM2, psc_at(TIM2_IDLE, tim_clk_hz));
+#if MIDI_CLOCK
+    // Без UG: он перезагрузил бы ARR посреди периода тика. Пока clock идёт, регулятор
+    // частоту не меняет (midi_clock_busy); стоящий TIM4 берёт PSC по UG в set_period()
+    TIM4->PSC = psc_at(TIM4_MIDI_CLOCK, tim_clk_hz);
+#endif
+    midi_din_retime(tim_clk_hz); // APB2 /1: PCLK2 = HCLK
+    __enable_irq();
+}
+
+} // namespace ll
+
+#if !HAL_IRQ_HANDLERS
+extern "C" {
+    // EOC: чтение DR само сбрасывает флаг. OVR (отсчёт не забрали вовремя) просто
+    // сбрасываем — следующий придёт через 8 мс по TRGO.
+    void ADC_IRQHandler(void) { // CubeMX их не генерирует: .ioc, NVIC без IRQ handler
+        ISR_PROFILE_ENTER();
+        isr_adc_trigger_mark();
+        const uint32_t sr = ADC1->SR;
+        if (sr & ADC_SR_OVR) {
+            ADC1->SR = ~ADC_SR_OVR;
+        }
+        if (sr & ADC_SR_EOC) {
+            const uint16_t raw = static_cast<uint16_t>(ADC1->DR);
+            if (pwr_flag) {
+                adc_sample_isr(raw);
+            }
+            TRACE("adc: raw %u, sr 0x%02x", raw, sr);
+        }
+        ISR_PROFILE_EXIT(ISR_ID_ADC);
+    }
+
+    void TIM2_IRQHandler(void) {
+        ISR_PROFILE_ENTER();
+        if (TIM2->SR & TIM_SR_UIF) {
+            TIM2->SR = ~TIM_SR_UIF;
+            if (pwr_flag) {
+                idle_timeout = 1; // tud_disconnect() и STANDBY — в главном цикле
+            }
+        }
+        ISR_PROFILE_EXIT(ISR_ID_TIM2);
+    }
+
+    // TIM3 только выдаёт TRGO, его прерывания не разрешены: снимаем случайные флаги
+    void TIM3_IRQHandler(void) {
+        TIM3->SR = 0u;
+    }
+}
+#else
+// Путь HAL для сравнения цены. CubeMX эти обработчики не генерирует (.ioc: без IRQ handler),
+// иначе после регенерации они столкнулись бы с регистровыми
+extern "C" {
+    void ADC_IRQHandler(void) {
+        ISR_PROFILE_ENTER();
+        isr_adc_trigger_mark();
+        HAL_ADC_IRQHandler(&hadc1); // -> HAL_ADC_ConvCpltCallback (pedal.cpp)
+        ISR_PROFILE_EXIT(ISR_ID_ADC);
+    }
+
+    void TIM2_IRQHandler(void) {
+        ISR_PROFILE_ENTER();
+        HAL_TIM_IRQHandler(&htim2);
+        if (pwr_flag) {
+            idle_timeout = 1;
+        }
+        ISR_PROFILE_EXIT(ISR_ID_TIM2);
+    }
+
+    void TIM3_IRQHandler(void) {
+        HAL_TIM_IRQHandler(&htim3);
+    }
+}
+#endif
@@ -0,0 +1,61 @@
+/*
+ * ll_periph.h
+ * Регистровые обработчики ADC1, TIM2, TIM3 (EXTI0..3 — в pedal.cpp) вместо цепочки
+ * HAL_xxx_IRQHandler -> callback, и constexpr-таблица таймеров.
+ * CubeMX обработчики ADC1/TIM2/TIM3 не генерирует (в .ioc снят "Generate IRQ handler"),
+ * поэтому регенерация stm32f4xx_it.c их не вернёт.
+ */
+
+#ifndef LL_PERIPH_H_
+#define LL_PERIPH_H_
+
+#include <stdint.h>
+
+// HAL-версии обработчиков — в ll_periph.cpp, включаются при сборке:
+// cmake -DHAL_IRQ_HANDLERS=ON (для сравнения в пресете Bench).
+#ifndef HAL_IRQ_HANDLERS
+#define HAL_IRQ_HANDLERS    0
+#endif
+
+#ifdef __cplusplus
+namespace ll {
+
+// Таймеры на APB1: PCLK1 = 48 МГц, при делителе APB1 != 1 таймеры тактируются x2
+inline constexpr uint32_t TIM_CLK_HZ = 96000000u;
+
+struct TimCfg {
+    uint32_t psc;
+    uint32_t arr;
+};
+
+// Должны совпадать с Core/Src/tim.c (CubeMX); в Debug сверяются check_config()
+inline constexpr TimCfg TIM2_IDLE = { 9599u, 6000000u };     // 10 кГц, таймаут простоя 600 с
+inline constexpr TimCfg TIM3_ADC = { 95u, 8000u };            // 1 МГц, TRGO для ADC1 раз в 8 мс
+inline constexpr TimCfg TIM5_CLOCK = { 9599u, 0xFFFFFFFFu }; // 10 кГц, метки времени педалей
+inline constexpr TimCfg TIM4_MIDI_CLOCK = { 95u, 0xFFFFu };  // 1 МГц, ARR — период тика MIDI Clock (midi_clock.cpp)
+
+constexpr uint32_t tick_hz(const TimCfg& c) { return TIM_CLK_HZ / (c.psc + 1u); }
+constexpr uint32_t period_us(const TimCfg& c) { return (c.arr + 1u) * (1000000u / tick_hz(c)); }
+
+static_assert(tick_hz(TIM5_CLOCK) == 10000u, "TIM5: 100 us tick, pedal debounce constants depend on it");
+static_assert(tick_hz(TIM3_ADC) == 1000000u, "TIM3: 1 us tick, ADC trigger latency is read from TIM3->CNT");
+static_assert(period_us(TIM3_ADC) / 1000u == 8u, "TIM3: ADC sample period 8 ms");
+static_assert(tick_hz(TIM4_MIDI_CLOCK) == 1000000u, "TIM4: 1 us tick, clock period and ISR lateness are in us");
+
+// Предделитель, дающий тот же тик при другой частоте таймеров (см. clock_gov.cpp)
+constexpr uint32_t psc_at(const TimCfg& c, uint32_t tim_clk_hz) { return tim_clk_hz / tick_hz(c) - 1u; }
+
+// Сверка регистров таймеров с таблицей выше; при расхождении — Error_Handler()
+void check_config();
+
+// Серия преобразований ADC1 (PB0, канал 8) программным запуском до MX_ADC1_Init:
+// квалификация пробуждения в pwr_wake_qualify(), ядро ещё на HSI
+void adc_burst(uint16_t* buf, uint32_t n);
+
+// Пересчитать PSC TIM2/3/4/5 (и BRR USART1 MIDI DIN) под новую частоту, сохранив CNT и тик
+void retime(uint32_t tim_clk_hz);
+
+} // namespace ll
+#endif
+
+#endif /* LL_PERIPH_H_ */
@@ -0,0 +1,237 @@
+#include "midi_clock.hpp"
+#include "midi_out.hpp"
+#include "midi_din.hpp"
+#include "ll_periph.h"
+#include "irq_priority.h"
+#include "isr_profile.h"
+#include "tusb.h"
+#include "usb_profile.h"
+
+midi_clock_stats_t midi_clock_stats;
+
+#if MIDI_CLOCK
+
+// 0xF8 из TIM4 только пишется в tx_ff; без взвода по SOF он ждал бы главного цикла
+#if !USB_TX_SOF_SYNC
+#error "MIDI_CLOCK requires USB_TX_SOF_SYNC"
+#endif
+
+static constexpr uint32_t HOLD_STOP_TICKS = 8000u;      // 0.8 с — Stop / Continue
+static constexpr uint32_t HOLD_START_TICKS = 20000u;    // 2 с — Start с начала
+
+// ISR <-> главный цикл
+static volatile uint32_t period_q8 = 0u;        // 0 — темп не задан, TIM4 стоит
+static volatile uint32_t arr_active = 0u;       // ARR идущего периода (теневой, не читается)
+// Только ISR (и запуск до первого тика)
+static uint32_t arr_next = 0u;                  // записан в ARR, вступит на следующем тике
+static uint32_t frac = 0u;
+
+// Только главный цикл
+static uint32_t taps[TAP_HISTORY];
+static uint32_t tap_count = 0u;
+static uint32_t tap_last = 0u;
+static bool tap_series = false;
+static uint32_t interval = 0u;                  // сглаженный интервал тапов, тиков TIM5
+static uint32_t press_time = 0u;
+static bool press_open = false;
+static bool start_sent = false;                 // Start уже ушёл за это удержание
+static clock_run run;
+static uint8_t transport_pending = 0u;          // 0xFA/0xFB/0xFC, ещё не принятый tx_ff
+
+void midi_clock_init() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk; // DWT->CYCCNT для emit_us_max
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    RCC->APB1ENR |= RCC_APB1ENR_TIM4EN;
+    (void)RCC->APB1ENR;
+    TIM4->CR1 = TIM_CR1_ARPE | TIM_CR1_URS; // UG не вызывает прерывание
+    TIM4->PSC = ll::psc_at(ll::TIM4_MIDI_CLOCK, SystemCoreClock); // таймеры APB1 на HCLK, см. clock_gov.cpp
+    TIM4->ARR = ll::TIM4_MIDI_CLOCK.arr;
+    TIM4->DIER = TIM_DIER_UIE;
+    HAL_NVIC_EnableIRQ(TIM4_IRQn);
+}
+
+// Первый темп — запуск с нуля; дальше период меняет только ISR, с тика на тик
+static void set_period(uint32_t q8) {
+    const bool first = period_q8 == 0u;
+    period_q8 = q8;
+    if (first) {
+        frac = 0u;
+        arr_active = clock_next_arr(q8, frac);
+        TIM4->ARR = arr_active;
+        TIM4->EGR = TIM_EGR_UG;  // ARR в теневой регистр, CNT = 0
+        arr_next = clock_next_arr(q8, frac);
+        TIM4->ARR = arr_next;
+        TIM4->SR = ~TIM_SR_UIF;
+        TIM4->CR1 |= TIM_CR1_CEN;
+    }
+}
+
+// Clock выдохся: TIM4 стоп, тик, уже поднявший UIF, не уходит
+static void halt() {
+    __disable_irq();
+    TIM4->CR1 &= ~TIM_CR1_CEN;
+    TIM4->SR = ~TIM_SR_UIF;
+    NVIC_ClearPendingIRQ(TIM4_IRQn);
+    period_q8 = 0u;
+    __enable_irq();
+    midi_clock_stats.idle_stops++;
+}
+
+static void tap(uint32_t t) {
+    const uint32_t dt = t - tap_last;
+    tap_last = t;
+    if (!tap_series || dt > TAP_INTERVAL_MAX) {
+        tap_series = true;
+        tap_count = 0u;
+        return;
+    }
+    if (dt < TAP_INTERVAL_MIN) {
+        midi_clock_stats.outliers++; // дребезг или двойное нажатие
+        return;
+    }
+    for (uint32_t i = TAP_HISTORY - 1u; i > 0u; --i) {
+        taps[i] = taps[i - 1u];
+    }
+    taps[0] = dt;
+    if (tap_count < TAP_HISTORY) {
+        ++tap_count;
+    }
+    if (tap_count < 2u) {
+        return;
+    }
+    const uint32_t est = tap_estimate(taps, tap_count);
+    const uint32_t d = dt > est ? dt - est : est - dt;
+    if (4u * d > est) {
+        midi_clock_stats.outliers++;
+    }
+    interval = tap_smooth(interval, est);
+    run.tap(TIM5->CNT);
+    set_period(clock_period_q8(interval));
+}
+
+void midi_clock_press(uint32_t t) {
+    if (press_open) {
+        tap(press_time); // отпускание предыдущего нажатия не заметили
+    }
+    press_time = t;
+    press_open = true;
+    start_sent = false;
+    TIM2->CNT = 0;
+}
+
+// Транспорт из главного цикла: System Real-Time одним сообщением, UMP MT 1 (группа 1)
+// или пакет CIN 0xF (кабель 1 «Pedals»). Без хоста USB пропускается — только DIN
+static bool realtime_write(uint8_t status) {
+    if (!tud_midi_mounted()) {
+        return true;
+    }
+    if (midi_ump_active()) {
+        const uint32_t w = (0x1u << 28) | (static_cast<uint32_t>(status) << 16);
+        return midi_out_direct(&w, 1u);
+    }
+    const uint32_t w = MIDI_CIN_1BYTE_DATA | (static_cast<uint32_t>(status) << 8);
+    return midi_out_direct(&w, 0u);
+}
+
+static void send_realtime(uint8_t status) {
+    if (!realtime_write(status)) {
+        transport_pending = status;
+    }
+}
+
+static void transport_set(uint8_t status) {
+    if (run.set(status, TIM5->CNT, interval != 0u)) {
+        set_period(clock_period_q8(interval));
+    }
+    midi_din_realtime(status);
+    send_realtime(status);
+}
+
+// Удержание: Start — сразу по 2 с; Stop / Continue — по отпусканию после 0.8 с
+static void hold_check(bool held) {
+    if (!press_open) {
+        return;
+    }
+    const uint32_t len = TIM5->CNT - press_time;
+    if (held) {
+        if (len > HOLD_START_TICKS && !start_sent) {
+            start_sent = true;
+            transport_set(MIDI_START);
+        }
+        return;
+    }
+    press_open = false;
+    if (start_sent) {
+        return;
+    }
+    if (len > HOLD_STOP_TICKS) {
+        transport_set(run.state == transport::playing ? MIDI_STOP : MIDI_CONTINUE);
+    }
+    else {
+        tap(press_time);
+    }
+}
+
+void midi_clock_process(bool held) {
+    hold_check(held);
+    if (transport_pending != 0u) {
+        const uint8_t status = transport_pending;
+        transport_pending = 0u;
+        send_realtime(status);
+    }
+    midi_out_flush(); // 0xF8 из TIM4_IRQHandler уже в tx_ff; с USB_TX_SOF_SYNC endpoint взводит SOF
+    if (run.expire(TIM5->CNT)) {
+        halt();
+    }
+    if (run.state == transport::playing) {
+        TIM2->CNT = 0; // идёт воспроизведение — это активность
+    }
+}
+
+bool midi_clock_busy() {
+    return run.busy() || press_open || transport_pending != 0u;
+}
+
+uint32_t midi_clock_us_to_tick() {
+    if (period_q8 == 0u) {
+        return UINT32_MAX;
+    }
+    // CNT раньше ARR: тик между чтениями даёт остаток меньше настоящего, не больше
+    const uint32_t cnt = TIM4->CNT;
+    const uint32_t arr = arr_active;
+    return cnt <= arr ? arr - cnt + 1u : 0u;
+}
+
+extern "C" {
+    // Приоритет 0: 0xF8 уходит отсюда, а не из главного цикла — момент отправки не
+    // зависит от длины прохода цикла. USB: сразу в tx_ff (midi_out_realtime_isr),
+    // DIN: сразу в USART1->DR (midi_din_realtime_isr). Затем ARR следующего периода
+    // (предзагрузка — вступит в силу после текущего)
+    void TIM4_IRQHandler(void) {
+        ISR_PROFILE_ENTER();
+        if (TIM4->SR & TIM_SR_UIF) {
+            TIM4->SR = ~TIM_SR_UIF;
+            const uint32_t late_us = TIM4->CNT;
+            const uint32_t cycles_us = SystemCoreClock / 1000000u;
+            const uint32_t t0 = DWT->CYCCNT - late_us * cycles_us;
+            if (late_us > midi_clock_stats.isr_late_us_max) {
+                midi_clock_stats.isr_late_us_max = late_us;
+            }
+            midi_din_realtime_isr(MIDI_TIMING_CLOCK);
+            if (!midi_out_realtime_isr(MIDI_TIMING_CLOCK)) {
+                midi_clock_stats.dropped++;
+            }
+            const uint32_t emit_us = (DWT->CYCCNT - t0) / cycles_us;
+            if (emit_us > midi_clock_stats.emit_us_max) {
+                midi_clock_stats.emit_us_max = emit_us;
+            }
+            midi_clock_stats.ticks++;
+            arr_active = arr_next;
+            arr_next = clock_next_arr(period_q8, frac);
+            TIM4->ARR = arr_next;
+        }
+        ISR_PROFILE_EXIT(ISR_ID_CLOCK);
+    }
+}
+
+#endif
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdint.h>
+
+// Тап-темп и MIDI Clock (24 PPQN, 0xF8) от TIM4. cmake -DMIDI_CLOCK=ON:
+// педаль D вместо «←» становится педалью темпа.
+//   нажатие (короче 0.8 с) — тап: интервал берётся по меткам EXTI (TIM5, 100 мкс);
+//   удержание 0.8–2 с — Stop (0xFC) / Continue (0xFB), по отпусканию;
+//   удержание 2 с — Start (0xFA) с начала, сразу.
+// Темп: медиана последних интервалов, выбросы дальше ±25% от неё отбрасываются,
+// остальные усредняются; мелкие колебания сглаживаются (1/4), скачок > 25% —
+// новый темп, принимается сразу. Clock идёт с третьего тапа; без воспроизведения
+// (после Stop или одних тапов) — ещё CLOCK_IDLE_TICKS, чтобы ведомые подстроили
+// темп (MIDI 1.0 допускает 0xF8 и в остановке), затем TIM4 останавливается и не
+// держит HCLK и STOP. Start / Continue запускают его снова с прежним темпом.
+//
+// TIM4 считает 1 МГц, ARR с предзагрузкой: период тика — целые мкс из Q8,
+// дробный остаток копится (clock_next_arr), ошибка фазы < 1 мкс и не растёт.
+// 0xF8 отправляет сам TIM4_IRQHandler (приоритет 0) мимо очередей кабелей: в tx_ff
+// USB и в USART1->DR. DIN не начинает блок, который не успеет уйти до тика
+// (midi_clock_us_to_tick), поэтому к тику линия свободна. Джиттер на источнике —
+// задержка входа в прерывание; модель и замер — tests/test_midi_clock.cpp.
+
+// cmake -DMIDI_CLOCK=ON
+#ifndef MIDI_CLOCK
+#define MIDI_CLOCK      0
+#endif
+
+inline constexpr uint32_t TAP_HISTORY = 4u;             // интервалов в оценке
+inline constexpr uint32_t TAP_INTERVAL_MIN = 2400u;     // 240 мс, 250 BPM (тиков TIM5)
+inline constexpr uint32_t TAP_INTERVAL_MAX = 15000u;    // 1.5 с, 40 BPM; дольше — новая серия
+inline constexpr uint32_t CLOCK_PPQN = 24u;
+inline constexpr uint32_t CLOCK_IDLE_TICKS = 100000u;  // 10 с TIM5 без воспроизведения — clock стоп
+
+inline constexpr uint8_t MIDI_TIMING_CLOCK = 0xF8u;
+inline constexpr uint8_t MIDI_START = 0xFAu;
+inline constexpr uint8_t MIDI_CONTINUE = 0xFBu;
+inline constexpr uint8_t MIDI_STOP = 0xFCu;
+
+// Интервал тапов (тики TIM5 по 100 мкс) -> период тика clock, мкс Q8
+constexpr uint32_t clock_period_q8(uint32_t tap_interval) {
+    return tap_interval * 100u * 256u / CLOCK_PPQN;
+}
+
+static_assert(clock_period_q8(TAP_INTERVAL_MAX) >> 8 <= 0xFFFFu, "TIM4 is 16-bit: 40 BPM tick must fit ARR");
+
+// Оценка интервала по истории: медиана, затем среднее интервалов в пределах ±25% от неё
+constexpr uint32_t tap_estimate(const uint32_t* iv, uint32_t n) {
+    uint32_t s[TAP_HISTORY] = {};
+    for (uint32_t i = 0u; i < n; ++i) {
+        uint32_t j = i;
+        for (; j > 0u && s[j - 1u] > iv[i]; --j) {
+            s[j] = s[j - 1u];
+        }
+        s[j] = iv[i];
+    }
+    const uint32_t med = (s[(n - 1u) / 2u] + s[n / 2u]) / 2u;
+    uint32_t sum = 0u;
+    uint32_t cnt = 0u;
+    for (uint32_t i = 0u; i < n; ++i) {
+        const uint32_t d = iv[i] > med ? iv[i] - med : med - iv[i];
+        if (4u * d <= med) {
+            sum += iv[i];
+            ++cnt;
+        }
+    }
+    return cnt ? sum / cnt : med;
+}
+
+// Сглаживание: близкая оценка подтягивает темп на 1/4, далёкая (> 25%) заменяет его
+constexpr uint32_t tap_smooth(uint32_t current, uint32_t estimate) {
+    if (current == 0u) {
+        return estimate;
+    }
+    const uint32_t d = estimate > current ? estimate - current : current - estimate;
+    if (4u * d > current) {
+        return estimate;
+    }
+    return estimate > current ? current + d / 4u : current - d / 4u;
+}
+
+// Следующий ARR TIM4: целые мкс периода плюс перенос из дробного аккумулятора
+constexpr uint32_t clock_next_arr(uint32_t period_q8, uint32_t& frac) {
+    frac += period_q8 & 0xFFu;
+    uint32_t us = period_q8 >> 8;
+    if (frac >= 256u) {
+        frac -= 256u;
+        ++us;
+    }
+    return us - 1u;
+}
+
+// Худшее расхождение фазы с идеальной за ticks тиков, мкс Q8
+constexpr uint32_t clock_phase_error_q8(uint32_t period_q8, uint32_t ticks) {
+    uint32_t frac = 0u;
+    uint64_t actual = 0u;
+    uint32_t worst = 0u;
+    for (uint32_t t = 1u; t <= ticks; ++t) {
+        actual += (clock_next_arr(period_q8, frac) + 1u) * 256ull;
+        const uint64_t ideal = static_cast<uint64_t>(period_q8) * t;
+        const uint64_t err = actual > ideal ? actual - ideal : ideal - actual;
+        if (err > worst) {
+            worst = static_cast<uint32_t>(err);
+        }
+    }
+    return worst;
+}
+
+inline constexpr uint32_t tap_example[TAP_HISTORY] = { 5000u, 5000u, 5100u, 9000u };
+static_assert(tap_estimate(tap_example, 4u) == 5033u, "outlier tap rejected, rest averaged");
+static_assert(tap_smooth(5000u, 5100u) == 5025u && tap_smooth(5000u, 7000u) == 7000u, "tap smoothing");
+static_assert(clock_phase_error_q8(clock_period_q8(5000u), 24u * 64u) < 256u, "120 BPM: phase error < 1 us");
+static_assert(clock_phase_error_q8(clock_period_q8(4321u), 24u * 64u) < 256u, "138.8 BPM: phase error < 1 us");
+
+enum class transport : uint8_t {
+    stopped = 0, playing, paused
+};
+
+// Транспорт и ход clock без обращений к TIM4: решения главного цикла, собираются и в
+// tests/. Время — TIM5 (100 мкс), разности по модулю 2^32
+struct clock_run {
+    transport state = transport::stopped;
+    bool running = false;       // TIM4 идёт
+    uint32_t since = 0u;        // последний тап или транспорт
+
+    // Тап задал темп: clock идёт (или продолжает идти)
+    void tap(uint32_t now) {
+        running = true;
+        since = now;
+    }
+
+    // Start / Continue / Stop; true — clock стоял и его надо запустить (tempo — темп известен)
+    bool set(uint8_t status, uint32_t now, bool tempo) {
+        state = status == MIDI_STOP ? transport::paused : transport::playing;
+        since = now;
+        if (state == transport::playing && tempo && !running) {
+            running = true;
+            return true;
+        }
+        return false;
+    }
+
+    // Из главного цикла: true — CLOCK_IDLE_TICKS без воспроизведения, TIM4 остановить
+    bool expire(uint32_t now) {
+        if (running && state != transport::playing && now - since >= CLOCK_IDLE_TICKS) {
+            running = false;
+            return true;
+        }
+        return false;
+    }
+
+    // Держать HCLK и не уходить в STOP: воспроизведение или clock ещё не выдохся
+    bool busy() const {
+        return state == transport::playing || running;
+    }
+};
+
+struct midi_clock_stats_t {
+    uint32_t ticks;             // отправлено 0xF8
+    uint32_t isr_late_us_max;   // вход в TIM4_IRQHandler после события обновления, мкс
+    uint32_t emit_us_max;       // от события обновления до 0xF8 в tx_ff и DR, мкс — джиттер на источнике
+    uint32_t outliers;          // интервалов тапов, отброшенных как выбросы
+    uint32_t dropped;           // 0xF8 не принят USB: tx_ff и очередь отложенных полны
+    uint32_t idle_stops;        // TIM4 остановлен: CLOCK_IDLE_TICKS без воспроизведения
+};
+
+extern midi_clock_stats_t midi_clock_stats;
+
+#if MIDI_CLOCK
+void midi_clock_init();
+// Нажатие педали темпа прошло антидребезг; t — метка EXTI (TIM5)
+void midi_clock_press(uint32_t t);
+// Из главного цикла: 0xF8 и транспорт; held — педаль темпа зажата
+void midi_clock_process(bool held);
+// Воспроизведение, clock ещё не выдохся (clock_run::busy), удержание или ждёт транспорт
+bool midi_clock_busy();
+// Мкс до следующего 0xF8 (оценка снизу); UINT32_MAX — clock не идёт
+uint32_t midi_clock_us_to_tick();
+#else
+inline void midi_clock_init() {}
+inline void midi_clock_press(uint32_t t) { (void)t; }
+inline void midi_clock_process(bool held) { (void)held; }
+inline bool midi_clock_busy() { return false; }
+inline uint32_t midi_clock_us_to_tick() { return UINT32_MAX; }
+#endif
@@ -0,0 +1,472 @@
+#include "midi_din.hpp"
+#include "midi_out.hpp"
+#include "midi_clock.hpp"
+#include "main.h"
+#include "tusb.h"
+#include "diag_log.hpp"
+#include "trace.hpp"
+
+midi_din_stats_t midi_din_stats;
+
+#if MIDI_DIN
+
+static constexpr uint32_t DIN_BAUD = 31250u;
+static constexpr uint32_t DIN_QUEUE_SIZE = 16u;         // должно быть степенью 2
+static constexpr uint32_t DIN_RT_SIZE = 8u;             // должно быть степенью 2
+static constexpr uint32_t STATUS_REFRESH_TICKS = 10000u; // 1 с тишины — статус заново
+static constexpr uint32_t DMA_CHANNEL_USART1 = 4u;
+static constexpr uint32_t DIN_RX_SIZE = 256u;           // ~82 мс на 31250 бод; должно быть степенью 2
+static constexpr uint32_t RX_ACTIVE_TICKS = 100u;       // 10 мс после байта линия считается занятой
+static_assert((DIN_QUEUE_SIZE & (DIN_QUEUE_SIZE - 1u)) == 0u, "DIN_QUEUE_SIZE must be power of 2");
+static_assert((DIN_RX_SIZE & (DIN_RX_SIZE - 1u)) == 0u && DIN_RX_SIZE <= 0xFFFFu, "DIN_RX_SIZE must be power of 2");
+static_assert((DIN_RT_SIZE & (DIN_RT_SIZE - 1u)) == 0u, "DIN_RT_SIZE must be power of 2");
+static_assert(96000000u % DIN_BAUD == 0u && 24000000u % DIN_BAUD == 0u, "BRR exact at both clock levels");
+
+struct din_msg {
+    uint8_t len;
+    uint8_t b[3];
+};
+
+// Пишет и читает только главный цикл
+struct din_queue {
+    din_msg buf[DIN_QUEUE_SIZE];
+    uint32_t write_idx;
+    uint32_t read_idx;
+
+    bool empty() const { return write_idx == read_idx; }
+    bool push(const din_msg& m) {
+        if (write_idx - read_idx == DIN_QUEUE_SIZE) {
+            return false;
+        }
+        buf[write_idx++ & (DIN_QUEUE_SIZE - 1u)] = m;
+        return true;
+    }
+    const din_msg& front() const { return buf[read_idx & (DIN_QUEUE_SIZE - 1u)]; }
+};
+
+static din_queue q_note;    // ноты, Program Change
+static din_queue q_ctrl;    // CC, pressure, pitch bend
+static uint8_t rt[DIN_RT_SIZE];
+static uint32_t rt_write = 0u;
+static uint32_t rt_read = 0u;
+
+// Real-Time из TIM4_IRQHandler, заставший линию занятой: уходит из USART1_IRQHandler
+// по TXE, главный цикл до этого блоков не начинает
+static volatile uint8_t rt_isr = 0u;        // 0 — нет
+static volatile uint32_t rt_isr_cycles = 0u; // DWT->CYCCNT постановки
+
+static uint8_t block[DIN_BLOCK_MAX];
+static uint8_t running = 0u;        // последний канальный статус на линии; 0 — нет
+static uint32_t last_tx = 0u;       // TIM5 последнего запуска DMA
+
+// Приём: кольцо пишет DMA, главный цикл читает по rx_read (счёт байт без заворота).
+// rx_laps — число заворотов кольца, его увеличивает только прерывание TC
+static uint8_t rx_ring[DIN_RX_SIZE];
+static volatile uint32_t rx_laps = 0u;
+static uint32_t rx_read = 0u;
+static uint32_t rx_last = 0u;       // TIM5 последнего принятого байта
+static constexpr uint32_t EXTI_DIN_RX = EXTI_IMR_MR10; // старт-бит на PA10 будит STOP
+
+// Состояние разбора входного потока
+struct din_parser {
+    uint8_t status;     // текущее сообщение: канальное (running status) или System Common; 0 — нет
+    uint8_t need;       // байт данных в сообщении
+    uint8_t n;          // уже принято данных / байт SysEx в sx[]
+    uint8_t d[2];
+    bool sysex;         // внутри F0 ... F7
+    bool sysex_first;   // в UMP: следующий пакет SysEx — первый (START / COMPLETE)
+    uint8_t sx[3];
+};
+
+// Готовый пакет, ещё не принятый очередью кабеля
+struct din_packet {
+    uint8_t words;      // 0 — USB-MIDI 1.0, иначе UMP
+    uint32_t w[2];
+};
+
+static din_parser parser;
+static din_packet pending;
+static bool pending_valid = false;
+void midi_din_init() {
+    RCC->AHB1ENR |= RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_DMA2EN;
+    RCC->APB2ENR |= RCC_APB2ENR_USART1EN;
+    (void)RCC->APB2ENR;
+    // PA9 — AF7 USART1_TX, push-pull; PA10 — AF7 USART1_RX с подтяжкой вверх
+    // (выход оптрона — открытый коллектор). В MX_GPIO_Init оба аналоговые
+    GPIOA->AFR[1] = (GPIOA->AFR[1] & ~(GPIO_AFRH_AFSEL9 | GPIO_AFRH_AFSEL10)) |
+                    (7u << GPIO_AFRH_AFSEL9_Pos) | (7u << GPIO_AFRH_AFSEL10_Pos);
+    GPIOA->PUPDR = (GPIOA->PUPDR & ~GPIO_PUPDR_PUPD10) | GPIO_PUPDR_PUPD10_0;
+    GPIOA->MODER = (GPIOA->MODER & ~(GPIO_MODER_MODER9 | GPIO_MODER_MODER10)) |
+                   GPIO_MODER_MODER9_1 | GPIO_MODER_MODER10_1;
+
+    USART1->BRR = SystemCoreClock / DIN_BAUD; // APB2 /1 на обоих уровнях частоты
+    USART1->CR3 = USART_CR3_DMAT | USART_CR3_DMAR;
+    USART1->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE | USART_CR1_IDLEIE;
+
+    DMA2_Stream7->CR = 0u;
+    DMA2_Stream7->PAR = reinterpret_cast<uint32_t>(&USART1->DR);
+    DMA2_Stream7->CR = (DMA_CHANNEL_USART1 << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_DIR_0 | DMA_SxCR_TCIE;
+
+    // Приём: кольцо без остановки, прерывания на половине и конце — только разбудить цикл
+    DMA2_Stream2->CR = 0u;
+    DMA2->LIFCR = DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2;
+    DMA2_Stream2->PAR = reinterpret_cast<uint32_t>(&USART1->DR);
+    DMA2_Stream2->M0AR = reinterpret_cast<uint32_t>(rx_ring);
+    DMA2_Stream2->NDTR = DIN_RX_SIZE;
+    DMA2_Stream2->CR = (DMA_CHANNEL_USART1 << DMA_SxCR_CHSEL_Pos) | DMA_SxCR_MINC | DMA_SxCR_CIRC |
+                       DMA_SxCR_HTIE | DMA_SxCR_TCIE | DMA_SxCR_EN;
+
+    // EXTI10 на PA10: линия выбрана сразу, маска — только на время STOP
+    RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+    SYSCFG->EXTICR[2] &= ~SYSCFG_EXTICR3_EXTI10; // порт A
+    EXTI->FTSR |= EXTI_DIN_RX;
+
+    HAL_NVIC_EnableIRQ(DMA2_Stream7_IRQn);
+    HAL_NVIC_EnableIRQ(DMA2_Stream2_IRQn);
+    HAL_NVIC_EnableIRQ(USART1_IRQn);
+    HAL_NVIC_EnableIRQ(EXTI15_10_IRQn);
+}
+
+void midi_din_wake_arm() {
+    EXTI->PR = EXTI_DIN_RX;
+    EXTI->IMR |= EXTI_DIN_RX;
+}
+
+void midi_din_wake_disarm() {
+    EXTI->IMR &= ~EXTI_DIN_RX;
+    EXTI->PR = EXTI_DIN_RX;
+}
+
+void midi_din_retime(uint32_t pclk2_hz) {
+    USART1->BRR = pclk2_hz / DIN_BAUD;
+}
+
+void midi_din_send(const uint8_t* msg, uint8_t len) {
+    din_msg m = { len, { msg[0], len > 1u ? msg[1] : uint8_t(0u), len > 2u ? msg[2] : uint8_t(0u) } };
+    const uint8_t kind = msg[0] & 0xF0u;
+    if (kind == 0xB0u) {
+        // Ещё не отправленный CC того же контроллера устарел — заменяем значение
+        for (uint32_t i = q_ctrl.read_idx; i != q_ctrl.write_idx; ++i) {
+            din_msg& old = q_ctrl.buf[i & (DIN_QUEUE_SIZE - 1u)];
+            if (old.b[0] == m.b[0] && old.b[1] == m.b[1]) {
+                old.b[2] = m.b[2];
+                midi_din_stats.coalesced++;
+                return;
+            }
+        }
+    }
+    din_queue& q = (kind == 0x80u || kind == 0x90u || kind == 0xC0u) ? q_note : q_ctrl;
+    if (!q.push(m)) {
+        midi_din_stats.dropped++;
+    }
+}
+
+void midi_din_realtime(uint8_t status) {
+    if (rt_write - rt_read == DIN_RT_SIZE) {
+        midi_din_stats.dropped++;
+        return;
+    }
+    rt[rt_write++ & (DIN_RT_SIZE - 1u)] = status;
+}
+
+void midi_din_realtime_isr(uint8_t status) {
+    // Линия свободна, DMA стоит: байт уходит сразу. Иначе — по ближайшему TXE
+    if (rt_isr == 0u && (DMA2_Stream7->CR & DMA_SxCR_EN) == 0u && (USART1->SR & USART_SR_TXE) != 0u) {
+        USART1->DR = status;
+        midi_din_stats.bytes++;
+        return;
+    }
+    if (rt_isr != 0u) {
+        midi_din_stats.dropped++; // прошлый ещё ждёт: тики в 10 мс, такого быть не должно
+        return;
+    }
+    rt_isr = status;
+    rt_isr_cycles = DWT->CYCCNT;
+    midi_din_stats.rt_waited++;
+    USART1->CR1 |= USART_CR1_TXEIE; // приоритет 0: чтение-запись CR1 не прерывается
+}
+
+// Сообщение в блок с running status; false — не влезло, ждёт следующего блока
+static bool emit(uint32_t& n, uint32_t max, const din_msg& m) {
+    const bool channel = m.b[0] < 0xF0u;
+    const bool skip = channel && m.b[0] == running;
+    const uint32_t need = m.len - (skip ? 1u : 0u);
+    if (n + need > max) {
+        return false;
+    }
+    for (uint32_t i = skip ? 1u : 0u; i < m.len; ++i) {
+        block[n++] = m.b[i];
+    }
+    if (skip) {
+        midi_din_stats.status_saved++;
+    }
+    running = channel ? m.b[0] : 0u; // System Common сбрасывает running status
+    return true;
+}
+
+void midi_din_process() {
+    if ((DMA2_Stream7->CR & DMA_SxCR_EN) != 0u || rt_isr != 0u) {
+        return;
+    }
+    if (rt_read == rt_write && q_note.empty() && q_ctrl.empty()) {
+        return;
+    }
+    // Остаток до тика и запуск DMA — без прерываний между ними
+    __disable_irq();
+    const uint32_t max = din_block_max(midi_clock_us_to_tick(), (USART1->SR & USART_SR_TC) != 0u);
+    if (max == 0u) {
+        __enable_irq();
+        midi_din_stats.clock_holds++;
+        return; // блок ушёл бы на тик: ждём 0xF8, TIM4 разбудит цикл
+    }
+    const uint32_t now = TIM5->CNT;
+    if (now - last_tx > STATUS_REFRESH_TICKS) {
+        running = 0u;
+    }
+    uint32_t n = 0u;
+    while (rt_read != rt_write && n < max) {
+        block[n++] = rt[rt_read++ & (DIN_RT_SIZE - 1u)]; // Real-Time не трогает running status
+    }
+    din_queue* const order[] = { &q_note, &q_ctrl };
+    for (din_queue* q : order) {
+        while (!q->empty() && emit(n, max, q->front())) {
+            ++q->read_idx;
+        }
+    }
+    if (n == 0u) {
+        __enable_irq();
+        return;
+    }
+    midi_din_stats.bytes += n;
+    last_tx = now;
+    DMA2->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CHTIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+    DMA2_Stream7->M0AR = reinterpret_cast<uint32_t>(block);
+    DMA2_Stream7->NDTR = n;
+    USART1->SR = ~USART_SR_TC;
+    DMA2_Stream7->CR |= DMA_SxCR_EN;
+    __enable_irq();
+}
+
+// Сколько байт DMA записал в кольцо за всё время. NDTR и rx_laps читаются не атомарно:
+// NDTR уже перезагружен, а TC ещё не обработан — позиция окажется позади rx_read
+static uint32_t rx_written() {
+    uint32_t laps;
+    uint32_t ndtr;
+    do {
+        laps = rx_laps;
+        ndtr = DMA2_Stream2->NDTR;
+    } while (laps != rx_laps);
+    uint32_t w = laps * DIN_RX_SIZE + (DIN_RX_SIZE - ndtr);
+    if (static_cast<int32_t>(w - rx_read) < 0) {
+        w += DIN_RX_SIZE;
+    }
+    return w;
+}
+
+static void parser_reset() {
+    parser = din_parser{};
+    pending_valid = false;
+}
+
+static void emit_packet(uint8_t cin, uint8_t b1, uint8_t b2, uint8_t b3) {
+    const uint32_t cable = static_cast<uint32_t>(midi_cable::din);
+    pending_valid = true;
+#if USB_MIDI2
+    if (midi_ump_active()) {
+        // MIDI 1.0 в UMP: канальные — MT 2, системные — MT 1, SysEx — MT 3 по 1..3 байта
+        pending.w[1] = 0u;
+        if (cin >= MIDI_CIN_NOTE_OFF && cin <= MIDI_CIN_PITCH_BEND_CHANGE) {
+            pending.words = 1u;
+            pending.w[0] = (0x2u << 28) | (cable << 24) | (uint32_t(b1) << 16) | (uint32_t(b2) << 8) | b3;
+        }
+        else if (cin == MIDI_CIN_SYSEX_START || (cin >= MIDI_CIN_SYSEX_END_1BYTE && cin <= MIDI_CIN_SYSEX_END_3BYTE && b1 != 0xF6u)) {
+            const bool end = cin != MIDI_CIN_SYSEX_START;
+            const uint8_t raw[3] = { b1, b2, b3 };
+            const uint32_t len = end ? cin - MIDI_CIN_SYSEX_END_1BYTE + 1u : 3u;
+            uint8_t d[3] = {};
+            uint32_t n = 0u;
+            for (uint32_t i = 0u; i < len; ++i) {
+                if (raw[i] < 0x80u) {
+                    d[n++] = raw[i]; // F0/F7 в UMP не передаются
+                }
+            }
+            const uint32_t status = parser.sysex_first ? (end ? 0x0u : 0x1u) : (end ? 0x3u : 0x2u);
+            parser.sysex_first = false;
+            pending.words = 2u;
+            pending.w[0] = (0x3u << 28) | (cable << 24) | (status << 20) | (n << 16) | (uint32_t(d[0]) << 8) | d[1];
+            pending.w[1] = uint32_t(d[2]) << 24;
+        }
+        else {
+            pending.words = 1u;
+            pending.w[0] = (0x1u << 28) | (cable << 24) | (uint32_t(b1) << 16) | (uint32_t(b2) << 8) | b3;
+        }
+        return;
+    }
+#endif
+    pending.words = 0u;
+    pending.w[0] = (cable << 4) | cin | (uint32_t(b1) << 8) | (uint32_t(b2) << 16) | (uint32_t(b3) << 24);
+}
+
+// Один байт с разъёма; каждый байт даёт не больше одного пакета
+static void parse(uint8_t b) {
+    din_parser& p = parser;
+    if (b >= 0xF8u) {
+        emit_packet(MIDI_CIN_1BYTE_DATA, b, 0u, 0u); // Real-Time — в любом месте потока
+        return;
+    }
+    if (b == 0xF0u) {
+        p.status = 0u;
+        p.sysex = true;
+        p.sysex_first = true;
+        p.sx[0] = b;
+        p.n = 1u;
+        return;
+    }
+    if (b == 0xF7u) {
+        if (p.sysex) {
+            p.sx[p.n++] = b;
+            emit_packet(static_cast<uint8_t>(MIDI_CIN_SYSEX_END_1BYTE + p.n - 1u), p.sx[0],
+                        p.n > 1u ? p.sx[1] : uint8_t(0u), p.n > 2u ? p.sx[2] : uint8_t(0u));
+            p.sysex = false;
+            p.n = 0u;
+        }
+        return;
+    }
+    if (b >= 0x80u) {
+        // Любой статус, кроме Real-Time, обрывает SysEx: недописанный хвост выбрасывается
+        p.sysex = false;
+        p.n = 0u;
+        p.need = static_cast<uint8_t>(midi_msg_len(b) - 1u);
+        p.status = b;
+        if (p.need == 0u) {
+            if (b == 0xF6u) {
+                emit_packet(MIDI_CIN_SYSEX_END_1BYTE, b, 0u, 0u); // Tune Request — одиночный System Common
+            }
+            p.status = 0u; // F4/F5 не определены — пропускаются
+        }
+        return;
+    }
+    if (p.sysex) {
+        p.sx[p.n++] = b;
+        if (p.n == 3u) {
+            emit_packet(MIDI_CIN_SYSEX_START, p.sx[0], p.sx[1], p.sx[2]);
+            p.n = 0u;
+        }
+        return;
+    }
+    if (p.status == 0u) {
+        return; // данные без статуса
+    }
+    p.d[p.n++] = b;
+    if (p.n < p.need) {
+        return;
+    }
+    p.n = 0u;
+    if (p.status < 0xF0u) {
+        emit_packet(p.status >> 4, p.status, p.d[0], p.need > 1u ? p.d[1] : uint8_t(0u));
+    }
+    else {
+        // System Common: CIN 2/3 по длине; running status на них не распространяется
+        emit_packet(p.need == 1u ? MIDI_CIN_SYSCOM_2BYTE : MIDI_CIN_SYSCOM_3BYTE, p.status, p.d[0],
+                    p.need > 1u ? p.d[1] : uint8_t(0u));
+        p.status = 0u;
+    }
+}
+
+static bool pending_flush() {
+    if (!pending_valid) {
+        return true;
+    }
+    if (midi_out_free(midi_cable::din) == 0u) {
+        return false;
+    }
+    midi_out_raw(midi_cable::din, pending.w, pending.words);
+    midi_din_stats.rx_messages++;
+    pending_valid = false;
+    return true;
+}
+
+void midi_din_receive() {
+    const uint32_t written = rx_written();
+    if (written - rx_read > DIN_RX_SIZE) {
+        // DMA успел переписать непрочитанное: поток с этого места не разобрать
+        midi_din_stats.rx_overruns++;
+        LOG("din: rx overrun, %u bytes lost", written - rx_read - DIN_RX_SIZE);
+        rx_read = written - DIN_RX_SIZE;
+        parser_reset();
+    }
+    if (written != rx_read) {
+        rx_last = TIM5->CNT;
+        TIM2->CNT = 0; // клавиатура на DIN играет через мост — таймаут простоя заново
+    }
+    const bool mounted = tud_midi_mounted();
+    while (rx_read != written) {
+        if (mounted && !pending_flush()) {
+            midi_din_stats.rx_stalls++;
+            return; // байты остаются в кольце: обратное давление до очереди кабеля
+        }
+        pending_valid = false; // без хоста разбор идёт вхолостую — состояние потока не теряется
+        parse(rx_ring[rx_read++ & (DIN_RX_SIZE - 1u)]);
+        midi_din_stats.rx_bytes++;
+    }
+    if (mounted) {
+        pending_flush();
+    }
+}
+
+bool midi_din_busy() {
+    return (DMA2_Stream7->CR & DMA_SxCR_EN) != 0u || (USART1->SR & USART_SR_TC) == 0u ||
+           rt_isr != 0u || rt_read != rt_write || !q_note.empty() || !q_ctrl.empty() ||
+           pending_valid || rx_written() != rx_read || TIM5->CNT - rx_last < RX_ACTIVE_TICKS;
+}
+
+extern "C" {
+    // Конец блока: только сброс флагов — прерывание будит WFI, следующий блок
+    // собирает midi_din_process()
+    void DMA2_Stream7_IRQHandler(void) {
+        DMA2->HIFCR = DMA_HIFCR_CTCIF7 | DMA_HIFCR_CTEIF7 | DMA_HIFCR_CDMEIF7 | DMA_HIFCR_CFEIF7;
+    }
+
+    // Половина / конец кольца приёма: счёт заворотов для rx_written(), разбор — в цикле
+    void DMA2_Stream2_IRQHandler(void) {
+        if ((DMA2->LISR & DMA_LISR_TCIF2) != 0u) {
+            rx_laps = rx_laps + 1u;
+        }
+        TRACE("din: rx ring half/full, lap %u", rx_laps);
+        DMA2->LIFCR = DMA_LIFCR_CTCIF2 | DMA_LIFCR_CHTIF2 | DMA_LIFCR_CTEIF2 | DMA_LIFCR_CDMEIF2 | DMA_LIFCR_CFEIF2;
+    }
+
+    // Старт-бит в STOP: только сброс флага — выход из STOP и есть пробуждение
+    void EXTI15_10_IRQHandler(void) {
+        EXTI->PR = EXTI_DIN_RX;
+        midi_din_stats.rx_wakes++;
+    }
+
+    // Линия затихла после пачки байт (или ошибка приёма): чтение SR, затем DR сбрасывает
+    // IDLE/ORE/FE/NE. Байт из DR при этом не теряется — RXNE сброшен, DMA его уже забрал
+    void USART1_IRQHandler(void) {
+        const uint32_t sr = USART1->SR;
+        // TXE для Real-Time из TIM4: DMA к этому моменту свой байт уже отдал
+        if ((USART1->CR1 & USART_CR1_TXEIE) != 0u && (sr & USART_SR_TXE) != 0u &&
+            (DMA2_Stream7->CR & DMA_SxCR_EN) == 0u) {
+            USART1->DR = rt_isr;
+            midi_din_stats.bytes++;
+            const uint32_t wait_us = (DWT->CYCCNT - rt_isr_cycles) / (SystemCoreClock / 1000000u);
+            if (wait_us > midi_din_stats.rt_wait_us_max) {
+                midi_din_stats.rt_wait_us_max = wait_us;
+            }
+            __disable_irq(); // CR1 пишет и TIM4_IRQHandler
+            rt_isr = 0u;
+            USART1->CR1 &= ~USART_CR1_TXEIE;
+            __enable_irq();
+        }
+        if ((sr & (USART_SR_IDLE | USART_SR_ORE | USART_SR_FE | USART_SR_NE)) != 0u) {
+            (void)USART1->DR;
+        }
+        if ((sr & (USART_SR_ORE | USART_SR_FE | USART_SR_NE)) != 0u) {
+            midi_din_stats.rx_errors++;
+        }
+    }
+}
+
+#endif
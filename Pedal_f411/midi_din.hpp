@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+
+// MIDI OUT на разъём DIN: USART1 TX (PA9, AF7), 31250 бод, передача по DMA2 Stream7.
+// cmake -DMIDI_DIN=ON. Работает и без хоста: события педалей дублируются сюда
+// из midi_out.cpp (ноты, CC после ограничителя) и midi_clock.cpp (0xF8, транспорт).
+//
+// Очереди с приоритетом: System Real-Time -> ноты и Program Change -> CC и прочее.
+// CC, ещё не ушедший в DMA, заменяется новым значением того же контроллера.
+// Running status: байт статуса опускается, если совпадает с предыдущим канальным
+// (CC подряд — 2 байта вместо 3, ~33% полосы); после секунды тишины статус
+// шлётся заново — для приёмника, подключённого на ходу.
+// Блок DMA — до DIN_BLOCK_MAX байт (~3 мс), чтобы нота не ждала длинный хвост CC.
+// Пока идёт MIDI Clock, блок начинается на свободной линии и обязан уйти до
+// следующего тика: 0xF8 из TIM4_IRQHandler пишется прямо в USART1->DR без ожидания.
+//
+// MIDI IN: USART1 RX (PA10, AF7) пишет в кольцо DMA2 Stream2 (circular), прерываний
+// на байт нет — только половина/конец кольца и IDLE линии, и те лишь будят цикл.
+// midi_din_receive() разбирает байты прямо в кольце (running status, Real-Time внутри
+// сообщений, SysEx) в пакеты USB-MIDI / UMP на кабеле midi_cable::din. Очередь кабеля
+// полна — байты остаются в кольце (~80 мс запаса), пока USB не заберёт своё.
+
+#include "usb_profile.h" // MIDI_DIN
+
+struct midi_din_stats_t {
+    uint32_t bytes;             // ушло в USART
+    uint32_t status_saved;      // байт статуса, опущенных running status
+    uint32_t coalesced;         // CC заменено более новым до отправки
+    uint32_t dropped;           // очередь полна
+    uint32_t rx_bytes;          // принято с разъёма
+    uint32_t rx_messages;       // пакетов отдано на кабель DIN
+    uint32_t rx_stalls;         // разбор остановлен: очередь кабеля полна
+    uint32_t rx_overruns;       // DMA обогнал разбор на целое кольцо, данные потеряны
+    uint32_t rx_errors;         // ошибки кадра / шум / переполнение USART
+    uint32_t rx_wakes;          // STOP прерван старт-битом на PA10
+    uint32_t clock_holds;       // блок отложен: не успел бы уйти до тика clock
+    uint32_t rt_waited;         // 0xF8 застал линию занятой и ждал TXE
+    uint32_t rt_wait_us_max;    // худшее такое ожидание, мкс
+};
+
+// Длина сообщения MIDI 1.0 по байту статуса (SysEx и данные — 1)
+constexpr uint8_t midi_msg_len(uint8_t status) {
+    return status < 0x80u ? 1u
+         : (status & 0xE0u) == 0xC0u ? 2u                       // Program Change, Channel Pressure
+         : status < 0xF0u ? 3u
+         : (status == 0xF1u || status == 0xF3u) ? 2u
+         : status == 0xF2u ? 3u
+         : 1u;
+}
+
+inline constexpr uint32_t DIN_BLOCK_MAX = 9u;          // 3 полных сообщения, ~2.9 мс
+inline constexpr uint32_t DIN_BYTE_US = 320u;           // 10 бит на 31250 бод
+inline constexpr uint32_t DIN_TICK_GUARD_US = 20u;      // запас блока до тика clock: запуск DMA, вход в TIM4
+
+// Байт в следующем блоке DMA. to_tick — мкс до 0xF8 (UINT32_MAX — clock не идёт),
+// line_idle — сдвиговый регистр пуст (TC). Пока идёт clock, блок начинается только на
+// свободной линии и кончается до тика: в TIM4_IRQHandler DR пуст и 0xF8 уходит сразу
+constexpr uint32_t din_block_max(uint32_t to_tick, bool line_idle) {
+    if (to_tick == UINT32_MAX) {
+        return DIN_BLOCK_MAX;
+    }
+    if (!line_idle || to_tick < DIN_TICK_GUARD_US) {
+        return 0u;
+    }
+    const uint32_t fit = (to_tick - DIN_TICK_GUARD_US) / DIN_BYTE_US;
+    return fit < DIN_BLOCK_MAX ? fit : DIN_BLOCK_MAX;
+}
+
+static_assert(din_block_max(UINT32_MAX, false) == DIN_BLOCK_MAX, "no clock: full blocks");
+static_assert(din_block_max(20833u, true) == DIN_BLOCK_MAX && din_block_max(1000u, true) == 3u &&
+              din_block_max(339u, true) == 0u && din_block_max(20833u, false) == 0u, "block ends before the tick");
+
+extern midi_din_stats_t midi_din_stats;
+
+#if MIDI_DIN
+void midi_din_init();
+// Канальное сообщение (1..3 байта, первый — статус)
+void midi_din_send(const uint8_t* msg, uint8_t len);
+// Один байт System Real-Time — вне очереди канальных, первым в следующем блоке
+void midi_din_realtime(uint8_t status);
+// Из TIM4_IRQHandler: байт System Real-Time сразу в USART1->DR, а если линия
+// занята — по ближайшему TXE, раньше следующего блока
+void midi_din_realtime_isr(uint8_t status);
+// Из главного цикла: собрать следующий блок и запустить DMA, если USART свободен
+void midi_din_process();
+// Из главного цикла, до midi_out_schedule(): принятые байты -> кабель DIN
+void midi_din_receive();
+// DMA или сдвиговый регистр USART ещё заняты, очереди не пусты или идёт приём
+bool midi_din_busy();
+// Из enter_stop(): спад на PA10 (EXTI10) будит STOP — USART в STOP стоит, первое
+// сообщение теряется, остальные принимаются уже на PLL
+void midi_din_wake_arm();
+void midi_din_wake_disarm();
+// Пересчитать BRR под новую частоту APB2 (ll::retime, вызывается при !midi_din_busy())
+void midi_din_retime(uint32_t pclk2_hz);
+#else
+inline void midi_din_init() {}
+inline void midi_din_send(const uint8_t* msg, uint8_t len) { (void)msg; (void)len; }
+inline void midi_din_realtime(uint8_t status) { (void)status; }
+inline void midi_din_realtime_isr(uint8_t status) { (void)status; }
+inline void midi_din_process() {}
+inline void midi_din_receive() {}
+inline bool midi_din_busy() { return false; }
+inline void midi_din_wake_arm() {}
+inline void midi_din_wake_disarm() {}
+inline void midi_din_retime(uint32_t pclk2_hz) { (void)pclk2_hz; }
+#endif
@@ -0,0 +1,210 @@
+#include "midi_in.hpp"
+#include "midi_out.hpp"
+#include "midi_din.hpp"
+#include "tusb.h"
+#include "stm32f4xx.h"
+
+static constexpr uint8_t MIDI_PEDAL_CH = 1u;            // канал 2, как MIDI_NOTE_CH в pedal.cpp
+static constexpr uint8_t NOTE_OFFSET_MAX = 66u;         // 61 + 66 = 127
+static constexpr uint32_t LED_ON = GPIO_PIN_13;
+static constexpr uint32_t LED_OFF = GPIO_PIN_13 << 16u;
+
+static constexpr uint32_t THRU_QUEUE_SIZE = 16u; // должно быть степенью 2
+static_assert((THRU_QUEUE_SIZE & (THRU_QUEUE_SIZE - 1u)) == 0u, "THRU_QUEUE_SIZE must be power of 2");
+
+midi_in_stats_t midi_in_stats;
+
+static uint8_t note_offset = 0u;
+
+struct thru_msg {
+    uint32_t time;      // TIM5 при приёме
+    uint8_t words;      // длина UMP в словах; 0 — пакет USB-MIDI 1.0 в w[0]
+    uint32_t w[4];
+};
+
+// Пишет и читает только главный цикл
+static thru_msg thru[THRU_QUEUE_SIZE];
+static uint32_t thru_write = 0u;
+static uint32_t thru_read = 0u;
+
+uint8_t midi_in_note_offset() {
+    return note_offset;
+}
+
+static void handle(uint8_t status, uint8_t d1, uint8_t d2, bool note_on_zero_is_off) {
+    if ((status & 0x0Fu) != MIDI_PEDAL_CH || status >= 0xF0u) {
+        return;
+    }
+    switch (status & 0xF0u) {
+    case 0x90u:
+        GPIOC->BSRR = (d2 == 0u && note_on_zero_is_off) ? LED_OFF : LED_ON;
+        break;
+    case 0x80u:
+        GPIOC->BSRR = LED_OFF;
+        break;
+    case 0xC0u:
+        note_offset = (2u * d1 < NOTE_OFFSET_MAX) ? static_cast<uint8_t>(2u * d1) : NOTE_OFFSET_MAX;
+        break;
+    default:
+        break;
+    }
+}
+
+#if MIDI_SOFT_THRU
+// Кабель входящего сообщения (в UMP — группа); чужие номера — на кабель педалей
+static midi_cable cable_of(const uint32_t* w, uint8_t words) {
+    const uint32_t c = words ? (w[0] >> 24) & 0xFu : (w[0] >> 4) & 0xFu;
+    return c < USB_MIDI_CABLES ? static_cast<midi_cable>(c) : midi_cable::pedals;
+}
+#endif
+
+static void thru_push(const uint32_t* w, uint8_t words) {
+#if MIDI_SOFT_THRU
+    if (thru_write - thru_read == THRU_QUEUE_SIZE) {
+        midi_in_stats.thru_dropped++;
+        return;
+    }
+    thru_msg& m = thru[thru_write & (THRU_QUEUE_SIZE - 1u)];
+    m.time = TIM5->CNT;
+    m.words = words;
+    for (uint32_t i = 0u; i < (words ? words : 1u); ++i) {
+        m.w[i] = w[i];
+    }
+    ++thru_write;
+#else
+    (void)w;
+    (void)words;
+#endif
+}
+
+// System Real-Time обгоняет очередь: его задержка важнее порядка
+static void thru_realtime(const uint32_t* w, uint8_t words) {
+#if MIDI_SOFT_THRU
+    if (!midi_out_direct(w, words)) {
+        midi_in_stats.thru_dropped++;
+    }
+#else
+    (void)w;
+    (void)words;
+#endif
+}
+
+// Перенос в очереди кабелей (midi_out.cpp), порядок прихода сохраняется
+bool midi_thru_flush() {
+#if MIDI_SOFT_THRU
+    const bool ump = midi_ump_active();
+    while (thru_read != thru_write) {
+        const thru_msg& m = thru[thru_read & (THRU_QUEUE_SIZE - 1u)];
+        if ((m.words != 0u) == ump) { // формат сменился (SET_INTERFACE) — сообщение выбрасывается
+            const midi_cable cable = cable_of(m.w, m.words);
+            if (midi_sysex_pending(cable) || !midi_out_raw(cable, m.w, m.words)) {
+                return false; // не разрывать свой SysEx; очередь кабеля полна
+            }
+            const uint32_t delay = TIM5->CNT - m.time;
+            if (delay > midi_in_stats.thru_delay_max) {
+                midi_in_stats.thru_delay_max = delay;
+            }
+        }
+        ++thru_read;
+    }
+#endif
+    return true;
+}
+
+// Кабель DIN: сообщение хоста — на разъём. Байты SysEx (F0, F7, данные) отсеиваются
+static bool din_bridge(uint32_t cable, uint8_t status, uint8_t d1, uint8_t d2) {
+#if MIDI_DIN
+    if (cable != static_cast<uint32_t>(midi_cable::din)) {
+        return false;
+    }
+    if (status >= 0xF8u) {
+        midi_din_realtime(status);
+    }
+    else if (status >= 0x80u && status != 0xF0u && status != 0xF7u) {
+        const uint8_t msg[3] = { status, d1, d2 };
+        midi_din_send(msg, midi_msg_len(status));
+    }
+    return true;
+#else
+    (void)cable;
+    (void)status;
+    (void)d1;
+    (void)d2;
+    return false;
+#endif
+}
+
+static void packet_in(const uint8_t p[4]) {
+    const uint8_t cin = p[0] & 0x0Fu;
+    if (cin == MIDI_CIN_MISC || cin == MIDI_CIN_CABLE_EVENT) {
+        return; // зарезервировано
+    }
+    uint32_t w;
+    memcpy(&w, p, sizeof(w));
+    midi_in_stats.messages++;
+    if (din_bridge(p[0] >> 4, p[1], p[2], p[3])) {
+        return;
+    }
+    if (cin == MIDI_CIN_1BYTE_DATA && p[1] >= 0xF8u) {
+        midi_in_stats.realtime++;
+        thru_realtime(&w, 0u);
+        return;
+    }
+    handle(p[1], p[2], p[3], true);
+    thru_push(&w, 0u);
+}
+
+#if USB_MIDI2
+static void ump_in(const uint32_t* w, uint8_t words) {
+    const uint32_t mt = w[0] >> 28;
+    const uint8_t status = static_cast<uint8_t>(w[0] >> 16);
+    midi_in_stats.messages++;
+    const uint32_t group = (w[0] >> 24) & 0xFu;
+    if (MIDI_DIN && group == static_cast<uint32_t>(midi_cable::din)) {
+        // На разъём — только MIDI 1.0 в UMP (MT 1, 2); SysEx7 и MIDI 2.0 CV отбрасываются
+        if (mt == 0x1u || mt == 0x2u) {
+            din_bridge(group, status, (w[0] >> 8) & 0x7Fu, w[0] & 0x7Fu);
+        }
+        return;
+    }
+    if (mt == 0x1u && status >= 0xF8u) {
+        midi_in_stats.realtime++;
+        thru_realtime(w, words);
+        return;
+    }
+    if (mt == 0x2u) {           // MIDI 1.0 Channel Voice
+        handle(status, (w[0] >> 8) & 0x7Fu, w[0] & 0x7Fu, true);
+    }
+    else if (mt == 0x4u) {      // MIDI 2.0 Channel Voice: velocity 16 бит, программа в w[1]
+        const uint8_t d1 = (status & 0xF0u) == 0xC0u ? (w[1] >> 24) & 0x7Fu : (w[0] >> 8) & 0x7Fu;
+        handle(status, d1, static_cast<uint8_t>(w[1] >> 25), false);
+    }
+    thru_push(w, words);
+}
+#endif
+
+void midi_in_process() {
+    bool received = false;
+#if USB_MIDI2
+    if (midi_ump_active()) {
+        uint32_t w[4];
+        uint32_t n;
+        while ((n = tud_midi_n_ump_read(0, w)) != 0u) {
+            ump_in(w, static_cast<uint8_t>(n));
+            received = true;
+        }
+    }
+    else
+#endif
+    {
+        uint8_t p[4];
+        while (tud_midi_packet_read(p)) {
+            packet_in(p);
+            received = true;
+        }
+    }
+    if (received) {
+        TIM2->CNT = 0; // хост играет через порт (thru, DIN) — это активность
+    }
+    midi_thru_flush();
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stdint.h>
+
+// Приём MIDI от хоста (OUT endpoint). midi_in_process() из главного цикла
+// выбирает из rx_ff все сообщения целиком — пакеты USB-MIDI 1.0 или UMP —
+// без побайтовой сборки потока, и:
+//  - реагирует на сообщения канала педали: Note On/Off — светодиод,
+//    Program Change n — ноты педалей A/B сдвигаются на 2n полутонов;
+//  - при MIDI_SOFT_THRU возвращает их хосту, смешивая с выводом педали:
+//    System Real-Time — сразу, в обход очереди; остальное — в порядке прихода,
+//    раньше любого более позднего события педали (midi_thru_flush в midi_out.cpp).
+// Сообщения хоста на кабеле DIN (MIDI_DIN) уходят на разъём, а не в thru;
+// SysEx на разъём не передаётся.
+
+// cmake -DMIDI_SOFT_THRU=ON
+#ifndef MIDI_SOFT_THRU
+#define MIDI_SOFT_THRU  0
+#endif
+
+struct midi_in_stats_t {
+    uint32_t messages;          // разобрано сообщений
+    uint32_t realtime;          // из них System Real-Time
+    uint32_t thru_dropped;      // очередь thru была полна — сообщение потеряно
+    uint32_t thru_delay_max;    // худшее ожидание в очереди thru, тиков TIM5 (100 мкс)
+};
+
+extern midi_in_stats_t midi_in_stats;
+
+void midi_in_process();
+
+// Сдвиг нот педалей по последнему Program Change на канале педали, полутонов
+uint8_t midi_in_note_offset();
+
+// Отправить накопленный thru. false — в TX FIFO не хватило места, часть осталась
+bool midi_thru_flush();
@@ -0,0 +1,560 @@
+#include "midi_out.hpp"
+#include "midi_in.hpp"
+#include "midi_din.hpp"
+#include "tusb.h"
+#include "stm32f4xx.h"
+#include "diag_log.hpp"
+
+static constexpr uint32_t UMP_MT_SYSEX7 = 0x3u;     // Data 64: SysEx 7 бит
+static constexpr uint32_t UMP_MT_CV2 = 0x4u;        // MIDI 2.0 Channel Voice
+static constexpr uint32_t SYSEX7_MAX = 6u;          // байт данных в одном UMP SysEx7
+static constexpr uint32_t SYSEX_PACKET_MAX = 3u;    // байт в одном пакете USB-MIDI 1.0
+
+static constexpr uint32_t CABLE_QUEUE_SIZE = 16u; // должно быть степенью 2
+static_assert((CABLE_QUEUE_SIZE & (CABLE_QUEUE_SIZE - 1u)) == 0u, "CABLE_QUEUE_SIZE must be power of 2");
+
+enum sysex7_status : uint32_t {
+    SYSEX7_COMPLETE = 0u, SYSEX7_START, SYSEX7_CONTINUE, SYSEX7_END
+};
+
+// words == 0 — пакет USB-MIDI 1.0 в w[0], иначе UMP.
+// stamped — событие с меткой захвата time (TIM5), см. MIDI_TIMESTAMPS
+struct out_msg {
+    uint8_t words;
+    bool stamped;
+    uint32_t time;
+    uint32_t w[4];
+};
+
+// Пишет и читает только главный цикл
+struct cable_queue {
+    out_msg buf[CABLE_QUEUE_SIZE];
+    uint32_t write_idx;
+    uint32_t read_idx;
+    bool sysex_open;    // свой SysEx начат, но F7 ещё не ушёл
+};
+
+static constexpr uint32_t CABLES = USB_MIDI_CABLES;
+
+static cable_queue queues[CABLES];
+static uint32_t rr_next = 0u; // кабель, с которого начнётся следующий обход
+
+midi_out_stats_t midi_out_stats;
+
+bool midi_ump_active() {
+#if USB_MIDI2
+    return tud_midi_n_ump_mode(0);
+#else
+    return false;
+#endif
+}
+
+// tx_ff пишут главный цикл (send) и TIM4_IRQHandler (midi_out_realtime_isr), а у
+// tu_fifo может быть только один писатель за раз. Пока главный цикл пишет, tx_busy
+// поднят: Real-Time из прерывания тогда откладывается в rt_defer и дописывается
+// сразу по окончании записи, в tx_end(). Окно — одна запись в tx_ff, единицы мкс
+static constexpr uint32_t RT_DEFER_SIZE = 4u; // должно быть степенью 2
+static_assert((RT_DEFER_SIZE & (RT_DEFER_SIZE - 1u)) == 0u, "RT_DEFER_SIZE must be power of 2");
+
+static volatile bool tx_busy = false;
+static uint8_t rt_defer[RT_DEFER_SIZE];
+static volatile uint32_t rt_defer_write = 0u;
+static volatile uint32_t rt_defer_read = 0u;
+
+// System Real-Time одним сообщением: UMP MT 1 (группа 1) или пакет CIN 0xF (кабель 1).
+// Только в tx_ff, endpoint не трогает: годится и для прерывания
+static bool rt_write(uint8_t status) {
+    const uint32_t w = midi_ump_active() ? (0x1u << 28) | (static_cast<uint32_t>(status) << 16)
+                                         : MIDI_CIN_1BYTE_DATA | (static_cast<uint32_t>(status) << 8);
+    return tud_midi_n_write_isr(0, &w, sizeof(w));
+}
+
+// Отложенные Real-Time по порядку; вызывать, когда других писателей tx_ff нет
+static void rt_drain() {
+    while (rt_defer_read != rt_defer_write && rt_write(rt_defer[rt_defer_read & (RT_DEFER_SIZE - 1u)])) {
+        rt_defer_read = rt_defer_read + 1u;
+    }
+}
+
+static void tx_end() {
+    __disable_irq(); // тик между rt_drain() и снятием флага остался бы в rt_defer до следующей записи
+    rt_drain();
+    tx_busy = false;
+    __enable_irq();
+}
+
+static bool send(const uint32_t* w, uint8_t words) {
+    tx_busy = true;
+    bool ok;
+#if USB_MIDI2
+    if (words != 0u) {
+        ok = tud_midi_n_ump_write(0, w, words) == words;
+    }
+    else
+#endif
+    {
+        ok = tud_midi_n_packet_write(0, reinterpret_cast<const uint8_t*>(w));
+    }
+    tx_end();
+    return ok;
+}
+
+static uint32_t queue_free(const cable_queue& q) {
+    return CABLE_QUEUE_SIZE - (q.write_idx - q.read_idx);
+}
+
+static bool push_at(midi_cable cable, const uint32_t* w, uint8_t words, bool stamped, uint32_t time) {
+    const uint32_t c = static_cast<uint32_t>(cable);
+    cable_queue& q = queues[c];
+    if (queue_free(q) == 0u) {
+        midi_out_stats.dropped[c]++;
+        return false;
+    }
+    out_msg& m = q.buf[q.write_idx & (CABLE_QUEUE_SIZE - 1u)];
+    m.words = words;
+    m.stamped = stamped && MIDI_TIMESTAMPS;
+    m.time = time;
+    for (uint32_t i = 0u; i < (words ? words : 1u); ++i) {
+        m.w[i] = w[i];
+    }
+    ++q.write_idx;
+    const uint32_t depth = q.write_idx - q.read_idx;
+    if (depth > midi_out_stats.depth_max[c]) {
+        midi_out_stats.depth_max[c] = depth;
+    }
+    return true;
+}
+
+static bool push(midi_cable cable, const uint32_t* w, uint8_t words) {
+    return push_at(cable, w, words, false, 0u);
+}
+
+// Пакет USB-MIDI 1.0: CIN и кабель в первом байте, порядок байт — как в tx_ff
+static uint32_t packet(midi_cable cable, uint8_t cin, uint8_t b1, uint8_t b2, uint8_t b3) {
+    return (static_cast<uint32_t>(cable) << 4) | cin | (static_cast<uint32_t>(b1) << 8) |
+           (static_cast<uint32_t>(b2) << 16) | (static_cast<uint32_t>(b3) << 24);
+}
+
+#if USB_MIDI2
+static uint32_t ump_head(uint32_t mt, midi_cable cable, uint8_t status, uint8_t b1, uint8_t b2) {
+    return (mt << 28) | (static_cast<uint32_t>(cable) << 24) | (static_cast<uint32_t>(status) << 16) |
+           (static_cast<uint32_t>(b1) << 8) | b2;
+}
+
+static bool ump_push(midi_cable cable, uint32_t w0, uint32_t w1, bool stamped, uint32_t time) {
+    const uint32_t ump[2] = { w0, w1 };
+    return push_at(cable, ump, 2u, stamped, time);
+}
+#endif
+
+bool midi_sysex_pending(midi_cable cable) {
+    return queues[static_cast<uint32_t>(cable)].sysex_open;
+}
+
+bool midi_out_raw(midi_cable cable, const uint32_t* w, uint8_t words) {
+    uint32_t ump[4];
+    const uint32_t n = words ? words : 1u;
+    for (uint32_t i = 0u; i < n; ++i) {
+        ump[i] = w[i];
+    }
+    ump[0] = words ? (ump[0] & ~(0xFu << 24)) | (static_cast<uint32_t>(cable) << 24)
+                   : (ump[0] & ~0xF0u) | (static_cast<uint32_t>(cable) << 4);
+    return push(cable, ump, words);
+}
+
+uint32_t midi_out_free(midi_cable cable) {
+    return queue_free(queues[static_cast<uint32_t>(cable)]);
+}
+
+bool midi_out_direct(const uint32_t* w, uint8_t words) {
+    return send(w, words);
+}
+
+bool midi_out_realtime_isr(uint8_t status) {
+    if (!tud_midi_mounted()) {
+        return true; // без хоста не копится
+    }
+    if (!tx_busy) {
+        rt_drain();
+        if (rt_defer_read == rt_defer_write && rt_write(status)) {
+            return true;
+        }
+    }
+    if (rt_defer_write - rt_defer_read == RT_DEFER_SIZE) {
+        midi_out_stats.rt_dropped++;
+        return false;
+    }
+    rt_defer[rt_defer_write & (RT_DEFER_SIZE - 1u)] = status;
+    rt_defer_write = rt_defer_write + 1u;
+    midi_out_stats.rt_deferred++;
+    return true;
+}
+
+void midi_out_flush() {
+    if (tud_midi_mounted()) {
+        tud_midi_n_write_flush(0);
+    }
+}
+
+bool midi_note_on(midi_cable cable, uint8_t status, uint8_t note, uint16_t velocity, uint32_t time) {
+    midi_thru_flush();
+    const uint8_t din[3] = { status, note, static_cast<uint8_t>(velocity >> 9) };
+    midi_din_send(din, sizeof(din));
+#if USB_MIDI2
+    if (midi_ump_active()) {
+        return ump_push(cable, ump_head(UMP_MT_CV2, cable, status, note, 0u), static_cast<uint32_t>(velocity) << 16, true, time);
+    }
+#endif
+    const uint32_t p = packet(cable, status >> 4, status, note, static_cast<uint8_t>(velocity >> 9));
+    return push_at(cable, &p, 0u, true, time);
+}
+
+static bool cc_push(midi_cable cable, uint8_t status, uint8_t index, uint8_t cc7, uint32_t value, uint32_t time) {
+    const uint8_t din[3] = { status, index, cc7 };
+    midi_din_send(din, sizeof(din)); // после ограничителя частоты — DIN получает ту же ограниченную полосу
+#if USB_MIDI2
+    if (midi_ump_active()) {
+        return ump_push(cable, ump_head(UMP_MT_CV2, cable, status, index, 0u), value, true, time);
+    }
+#else
+    (void)value;
+#endif
+    const uint32_t p = packet(cable, status >> 4, status, index, cc7);
+    return push_at(cable, &p, 0u, true, time);
+}
+
+#if MIDI_CC_RATE
+static constexpr uint32_t CC_BUCKETS = 4u;
+static constexpr uint32_t TOKEN = 10000u;   // токен = 1 сообщение; тик TIM5 добавляет MIDI_CC_RATE / 10000
+static constexpr uint32_t REFILL_DT_MAX = 100000u; // 10 с — дальше ведро всё равно полно
+
+struct cc_sample {
+    uint8_t cc7;
+    uint32_t value;
+    uint32_t time;
+};
+
+// Ведро на (кабель, статус, номер CC). Отложено до двух значений: hold[0] —
+// точка разворота (конец отрезка развёртки), hold[held - 1] — последнее
+struct cc_bucket {
+    bool used;
+    midi_cable cable;
+    uint8_t status;
+    uint8_t index;
+    uint32_t tokens;        // в TOKEN-долях
+    uint32_t refill_time;   // TIM5
+    uint32_t sent_value;    // последнее отправленное — для поиска разворота
+    uint8_t held;
+    cc_sample hold[2];
+};
+
+static cc_bucket buckets[CC_BUCKETS];
+
+static cc_bucket* bucket_for(midi_cable cable, uint8_t status, uint8_t index) {
+    cc_bucket* free_slot = nullptr;
+    for (cc_bucket& b : buckets) {
+        if (b.used && b.cable == cable && b.status == status && b.index == index) {
+            return &b;
+        }
+        if (!b.used && free_slot == nullptr) {
+            free_slot = &b;
+        }
+    }
+    if (free_slot != nullptr) {
+        *free_slot = {};
+        free_slot->used = true;
+        free_slot->cable = cable;
+        free_slot->status = status;
+        free_slot->index = index;
+        free_slot->tokens = MIDI_CC_BURST * TOKEN;
+        free_slot->refill_time = TIM5->CNT;
+    }
+    return free_slot;
+}
+
+static void refill(cc_bucket& b) {
+    const uint32_t now = TIM5->CNT;
+    uint32_t dt = now - b.refill_time;
+    b.refill_time = now;
+    if (dt > REFILL_DT_MAX) {
+        dt = REFILL_DT_MAX;
+    }
+    const uint32_t full = MIDI_CC_BURST * TOKEN;
+    b.tokens = (full - b.tokens > dt * MIDI_CC_RATE) ? b.tokens + dt * MIDI_CC_RATE : full;
+}
+
+static bool turning(uint32_t a, uint32_t b, uint32_t c) {
+    return (b > a && c < b) || (b < a && c > b);
+}
+
+static uint32_t swing(uint32_t a, uint32_t b) {
+    return a > b ? a - b : b - a;
+}
+
+// Отложенные значения уходят по мере токенов, по порядку. Конец задержки —
+// итог счётчиков ограничителя в журнал
+static void bucket_flush(cc_bucket& b) {
+    refill(b);
+    while (b.held != 0u && b.tokens >= TOKEN) {
+        const cc_sample& s = b.hold[0];
+        if (!cc_push(b.cable, b.status, b.index, s.cc7, s.value, s.time)) {
+            return;
+        }
+        b.tokens -= TOKEN;
+        b.sent_value = s.value;
+        b.hold[0] = b.hold[1];
+        --b.held;
+        midi_out_stats.cc_released++;
+        if (b.held == 0u) {
+            LOG("cc: limited %u, merged %u, turns dropped %u, released %u", midi_out_stats.cc_limited,
+                midi_out_stats.cc_coalesced, midi_out_stats.cc_turn_dropped, midi_out_stats.cc_released);
+        }
+    }
+}
+
+// Без токена значение откладывается. Промежуточные точки развёртки сливаются в
+// последнюю; разворот (конец отрезка) держится отдельно. Два разворота подряд при
+// занятых слотах: новое значение — всегда в hold[1], из двух прежних концов
+// остаётся тот, чей размах (меньший из двух соседних отрезков) больше
+static void bucket_hold(cc_bucket& b, const cc_sample& s) {
+    midi_out_stats.cc_limited++;
+    if (b.held == 0u) {
+        b.hold[0] = s;
+        b.held = 1u;
+        return;
+    }
+    if (b.held == 1u) {
+        if (turning(b.sent_value, b.hold[0].value, s.value)) {
+            b.hold[1] = s;
+            b.held = 2u;
+            return;
+        }
+        b.hold[0] = s;
+        midi_out_stats.cc_coalesced++;
+        return;
+    }
+    if (turning(b.hold[0].value, b.hold[1].value, s.value)) {
+        const uint32_t v0 = b.hold[0].value;
+        const uint32_t v1 = b.hold[1].value;
+        const uint32_t mid = swing(v0, v1);
+        const uint32_t swing0 = swing(b.sent_value, v0) < mid ? swing(b.sent_value, v0) : mid;
+        const uint32_t swing1 = swing(v1, s.value) < mid ? swing(v1, s.value) : mid;
+        if (swing1 >= swing0) {
+            b.hold[0] = b.hold[1];
+        }
+        b.hold[1] = s;
+        midi_out_stats.cc_turn_dropped++;
+        return;
+    }
+    b.hold[1] = s;
+    midi_out_stats.cc_coalesced++;
+}
+
+static void cc_rate_flush() {
+    for (cc_bucket& b : buckets) {
+        if (b.used && b.held != 0u) {
+            bucket_flush(b);
+        }
+    }
+}
+#endif
+
+bool midi_cc(midi_cable cable, uint8_t status, uint8_t index, uint8_t cc7, uint32_t value, uint32_t time) {
+    midi_thru_flush();
+#if MIDI_CC_RATE
+    cc_bucket* b = bucket_for(cable, status, index);
+    if (b == nullptr) {
+        midi_out_stats.cc_untracked++;
+    }
+    else {
+        bucket_flush(*b);
+        if (b->held != 0u || b->tokens < TOKEN) {
+            bucket_hold(*b, { cc7, value, time });
+            return true;
+        }
+        b->tokens -= TOKEN;
+        b->sent_value = value;
+    }
+#endif
+    return cc_push(cable, status, index, cc7, value, time);
+}
+
+uint32_t midi_sysex(midi_cable cable, const uint8_t* msg, uint32_t len) {
+    const cable_queue& q = queues[static_cast<uint32_t>(cable)];
+    uint32_t done = 0u;
+#if USB_MIDI2
+    if (midi_ump_active()) {
+        // F0/F7 в UMP не передаются: начало и конец — в поле status пакета
+        while (done < len && queue_free(q) != 0u) {
+            const uint8_t* p = msg + done;
+            const uint32_t skip = (p[0] == 0xF0u) ? 1u : 0u;
+            const uint32_t rest = len - done - skip;
+            const bool has_end = rest != 0u && p[skip + rest - 1u] == 0xF7u;
+            const uint32_t avail = rest - (has_end ? 1u : 0u);
+            const uint32_t n = avail < SYSEX7_MAX ? avail : SYSEX7_MAX;
+            const bool end = has_end && n == avail;
+            const uint32_t status = skip ? (end ? SYSEX7_COMPLETE : SYSEX7_START) : (end ? SYSEX7_END : SYSEX7_CONTINUE);
+
+            uint8_t d[SYSEX7_MAX] = {};
+            for (uint32_t i = 0u; i < n; ++i) {
+                d[i] = p[skip + i];
+            }
+            const uint32_t w0 = (UMP_MT_SYSEX7 << 28) | (static_cast<uint32_t>(cable) << 24) | (status << 20) | (n << 16) |
+                                (static_cast<uint32_t>(d[0]) << 8) | d[1];
+            const uint32_t w1 = (static_cast<uint32_t>(d[2]) << 24) | (static_cast<uint32_t>(d[3]) << 16) |
+                                (static_cast<uint32_t>(d[4]) << 8) | d[5];
+            ump_push(cable, w0, w1, false, 0u);
+            done += skip + n + (end ? 1u : 0u);
+        }
+    }
+    else
+#endif
+    {
+        // Тройки байт — CIN 4, последний пакет с F7 — CIN 5/6/7 по числу байт.
+        // Хвост без F7 короче трёх байт ждёт продолжения
+        while (done < len && queue_free(q) != 0u) {
+            const uint32_t rest = len - done;
+            uint32_t n = rest < SYSEX_PACKET_MAX ? rest : SYSEX_PACKET_MAX;
+            uint8_t b[SYSEX_PACKET_MAX] = {};
+            bool end = false;
+            for (uint32_t i = 0u; i < n; ++i) {
+                b[i] = msg[done + i];
+                if (b[i] == 0xF7u) {
+                    n = i + 1u;
+                    end = true;
+                    break;
+                }
+            }
+            if (!end && n < SYSEX_PACKET_MAX) {
+                break;
+            }
+            const uint8_t cin = end ? static_cast<uint8_t>(MIDI_CIN_SYSEX_END_1BYTE + n - 1u) : MIDI_CIN_SYSEX_START;
+            const uint32_t p = packet(cable, cin, b[0], b[1], b[2]);
+            push(cable, &p, 0u);
+            done += n;
+        }
+    }
+    if (done != 0u) {
+        queues[static_cast<uint32_t>(cable)].sysex_open = msg[done - 1u] != 0xF7u;
+    }
+    return done;
+}
+
+#if MIDI_TIMESTAMPS
+static constexpr uint8_t SYSEX_ID_NONCOMMERCIAL = 0x7Du;
+static constexpr uint8_t SYSEX_TIMESTAMP = 0x02u;
+static constexpr uint32_t TS_SYSEX_LEN = 14u;
+static constexpr uint32_t TS_SYSEX_PACKETS = (TS_SYSEX_LEN + SYSEX_PACKET_MAX - 1u) / SYSEX_PACKET_MAX;
+static constexpr uint32_t UMP_MT_UTILITY = 0x0u;
+static constexpr uint32_t UMP_JR_CLOCK = 0x1u;
+static constexpr uint32_t UMP_JR_TIMESTAMP = 0x2u;
+static constexpr uint32_t JR_CLOCK_PERIOD_TICKS = 2500u; // 250 мс: не реже, чем требует UMP
+
+static uint32_t jr_clock_last = 0u;
+
+// TIM5 (100 мкс) -> часы отправителя JR, 1/31250 с (32 мкс), 16 бит
+static uint32_t jr_time(uint32_t tim5) {
+    return static_cast<uint32_t>(static_cast<uint64_t>(tim5) * 25u / 8u) & 0xFFFFu;
+}
+
+static uint32_t jr_word(uint32_t status, uint32_t tim5) {
+    return (UMP_MT_UTILITY << 28) | (status << 20) | jr_time(tim5);
+}
+
+// MIDI 1.0: метка — отдельным SysEx на кабеле диагностики сразу за событием:
+// F0 7D 02 <кабель> <status & 7F> <data1> <возраст: 3 x 7 бит> <метка: 4 x 7 бит> F7.
+// Возраст — от захвата до tx_ff, тиков TIM5; хост ставит событие на (приход - возраст).
+// Не вставляется в незакрытый SysEx диагностики и при нехватке места — считается в ts_skipped
+static void timestamp_sysex(uint32_t cable, const out_msg& m) {
+    const cable_queue& diag = queues[static_cast<uint32_t>(midi_cable::diag)];
+    if (diag.sysex_open || queue_free(diag) < TS_SYSEX_PACKETS) {
+        midi_out_stats.ts_skipped++;
+        return;
+    }
+    const uint32_t age = TIM5->CNT - m.time;
+    const uint32_t age7 = age < 0x1FFFFFu ? age : 0x1FFFFFu;
+    const uint8_t msg[TS_SYSEX_LEN] = {
+        0xF0u, SYSEX_ID_NONCOMMERCIAL, SYSEX_TIMESTAMP, static_cast<uint8_t>(cable),
+        static_cast<uint8_t>((m.w[0] >> 8) & 0x7Fu), static_cast<uint8_t>((m.w[0] >> 16) & 0x7Fu),
+        static_cast<uint8_t>(age7 & 0x7Fu), static_cast<uint8_t>((age7 >> 7) & 0x7Fu), static_cast<uint8_t>((age7 >> 14) & 0x7Fu),
+        static_cast<uint8_t>(m.time & 0x7Fu), static_cast<uint8_t>((m.time >> 7) & 0x7Fu),
+        static_cast<uint8_t>((m.time >> 14) & 0x7Fu), static_cast<uint8_t>((m.time >> 21) & 0x7Fu),
+        0xF7u
+    };
+    midi_sysex(midi_cable::diag, msg, sizeof(msg));
+}
+#endif
+
+// Событие с меткой: в UMP перед ним JR Timestamp (одна запись — оба или ничего),
+// в MIDI 1.0 — SysEx-метка на кабель диагностики
+static bool send_msg(uint32_t cable, const out_msg& m) {
+#if MIDI_TIMESTAMPS
+    if (m.stamped) {
+#if USB_MIDI2
+        if (m.words != 0u) {
+            uint32_t ump[5] = { jr_word(UMP_JR_TIMESTAMP, m.time) };
+            for (uint32_t i = 0u; i < m.words; ++i) {
+                ump[1u + i] = m.w[i];
+            }
+            return send(ump, static_cast<uint8_t>(m.words + 1u));
+        }
+#endif
+        if (!send(m.w, 0u)) {
+            return false;
+        }
+        timestamp_sysex(cable, m);
+        return true;
+    }
+#else
+    (void)cable;
+#endif
+    return send(m.w, m.words);
+}
+
+// Круговой обход: с каждого непустого кабеля по одному сообщению, пока tx_ff
+// принимает. Упёрлись в полный tx_ff — следующий вызов начнёт с того же кабеля.
+// tx_ff вмещает один-два пакета endpoint'а, поэтому событие на тихом кабеле
+// ждёт не дольше кадра, сколько бы ни скопилось на соседнем
+void midi_out_schedule() {
+#if MIDI_CC_RATE
+    cc_rate_flush();
+#endif
+    const bool ump = midi_ump_active();
+#if MIDI_TIMESTAMPS && USB_MIDI2
+    // JR Clock — текущее время отправителя, опора для JR Timestamp у хоста
+    if (ump && TIM5->CNT - jr_clock_last > JR_CLOCK_PERIOD_TICKS) {
+        const uint32_t w = jr_word(UMP_JR_CLOCK, TIM5->CNT);
+        if (send(&w, 1u)) {
+            jr_clock_last = TIM5->CNT;
+        }
+    }
+#endif
+    uint32_t idle = 0u; // кабелей подряд без сообщений
+    for (uint32_t c = rr_next; idle < CABLES; c = (c + 1u) % CABLES) {
+        cable_queue& q = queues[c];
+        if (q.read_idx == q.write_idx) {
+            ++idle;
+            continue;
+        }
+        const out_msg& m = q.buf[q.read_idx & (CABLE_QUEUE_SIZE - 1u)];
+        if ((m.words != 0u) == ump) { // формат сменился (SET_INTERFACE) — сообщение выбрасывается
+            if (!send_msg(c, m)) {
+                rr_next = c;
+                return;
+            }
+            midi_out_stats.sent[c]++;
+        }
+        ++q.read_idx;
+        idle = 0u;
+        rr_next = (c + 1u) % CABLES;
+    }
+}
+
+bool midi_out_pending() {
+    for (const cable_queue& q : queues) {
+        if (q.read_idx != q.write_idx) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdint.h>
+#include "usb_profile.h"
+
+// Вывод MIDI в формате, который выбрал хост:
+//   alt 0 (USB-MIDI 1.0) — 4-байтные пакеты CIN, 7-битные значения;
+//   alt 1 (USB-MIDI 2.0, сборка с USB_MIDI2) — UMP MIDI 2.0 Channel Voice (64 бита):
+//   CC 32 бита, velocity 16 бит — одно сообщение вместо пары MSB/LSB.
+//
+// Каждый виртуальный кабель (в UMP — группа) имеет свою очередь. Сообщение
+// кладётся в очередь целиком или не кладётся (очередь полна) — возвращается false.
+// midi_out_schedule() из главного цикла переносит очереди в tx_ff по кругу, по
+// одному сообщению с кабеля: поток CC на одном кабеле не задерживает ноты на другом.
+// Перед событием педали в очередь уходит накопленный soft-thru (midi_in.hpp): он пришёл раньше.
+
+// Метки времени событий (cmake -DMIDI_TIMESTAMPS=ON): каждое событие педали несёт
+// время захвата по TIM5 — фронт EXTI для нот, отсчёт АЦП для CC. В UMP перед
+// сообщением идёт JR Timestamp (плюс JR Clock раз в 250 мс), в MIDI 1.0 — SysEx-метка
+// F0 7D 02 на кабеле диагностики с возрастом события на момент отправки.
+// Значение по умолчанию — в usb_profile.h.
+
+// Ограничение частоты CC (cmake -DMIDI_CC_RATE=<сообщений/с>, 0 — выкл.): ведро
+// токенов на (кабель, канал, CC) с запасом MIDI_CC_BURST. Без токена значение
+// откладывается и уходит, когда токен накопится: первое значение развёртки
+// уходит сразу (ведро полно), последнее и точка разворота не теряются,
+// промежуточные сливаются. Третий разворот за время задержки вытесняет из двух
+// прежних меньший (cc_turn_dropped). Итог счётчиков — в LOG по концу задержки. 100/с — ~10% полосы DIN 31.25 кбод на один CC.
+#ifndef MIDI_CC_RATE
+#define MIDI_CC_RATE        100
+#endif
+#ifndef MIDI_CC_BURST
+#define MIDI_CC_BURST       4
+#endif
+
+// Кабели = embedded jack'и дескриптора (usb_descriptors.c), DAW видит их отдельными портами
+enum class midi_cable : uint8_t {
+    pedals = 0,     // ноты педалей A/B
+    sustain,        // CC#64 педали sustain
+    diag,           // диагностические SysEx (boot_report и т.п.)
+    din,            // мост DIN <-> USB, только с MIDI_DIN
+    count = USB_MIDI_CABLES
+};
+
+static_assert(static_cast<uint32_t>(midi_cable::din) + MIDI_DIN == USB_MIDI_CABLES, "cable enum vs descriptor");
+
+struct midi_out_stats_t {
+    uint32_t sent[USB_MIDI_CABLES];      // ушло в tx_ff
+    uint32_t dropped[USB_MIDI_CABLES];   // очередь кабеля была полна
+    uint32_t depth_max[USB_MIDI_CABLES]; // худшая глубина очереди, сообщений
+    uint32_t ts_skipped;                 // SysEx-меток не отправлено: кабель диагностики занят
+    uint32_t cc_limited;                 // CC отложено ограничителем
+    uint32_t cc_coalesced;               // из них слито с более новым значением (не отправлено)
+    uint32_t cc_turn_dropped;            // из них разворот вытеснен: слоты заняты двумя другими
+    uint32_t cc_released;                // отложенных, отправленных позже
+    uint32_t cc_untracked;               // CC без свободного ведра — ушли без ограничения
+    uint32_t rt_deferred;                // Real-Time из прерывания ждал конца записи главного цикла
+    uint32_t rt_dropped;                 // Real-Time из прерывания потерян: tx_ff и очередь полны
+};
+
+extern midi_out_stats_t midi_out_stats;
+
+// true — хост выбрал alt 1, сообщения уходят как UMP
+bool midi_ump_active();
+
+// status — 0x90 | канал; velocity — 16 бит, для MIDI 1.0 берутся старшие 7;
+// time — TIM5 в момент физического события (нажатия)
+bool midi_note_on(midi_cable cable, uint8_t status, uint8_t note, uint16_t velocity, uint32_t time);
+// status — 0xB0 | канал; cc7 — значение для MIDI 1.0, value — 32 бита для UMP;
+// time — TIM5 отсчёта АЦП. Отложенное ограничителем частоты — тоже true
+bool midi_cc(midi_cable cable, uint8_t status, uint8_t index, uint8_t cc7, uint32_t value, uint32_t time);
+
+// SysEx F0 .. F7 целиком или его продолжение. Возвращает число принятых байт:
+// остаток передаётся следующим вызовом (пакеты USB-MIDI по 3 байта, UMP SysEx7 по 6)
+uint32_t midi_sysex(midi_cable cable, const uint8_t* msg, uint32_t len);
+// true — SysEx на кабеле передан не до конца: ждёт продолжения
+bool midi_sysex_pending(midi_cable cable);
+
+// Готовое сообщение в очередь кабеля: words == 0 — пакет USB-MIDI 1.0 в w[0],
+// иначе UMP из words (1..4) слов. Номер кабеля / группы подставляется
+bool midi_out_raw(midi_cable cable, const uint32_t* w, uint8_t words);
+// Свободных мест в очереди кабеля — для источников с обратным давлением (мост DIN)
+uint32_t midi_out_free(midi_cable cable);
+// Мимо очередей, сразу в tx_ff — для System Real-Time
+bool midi_out_direct(const uint32_t* w, uint8_t words);
+// Из прерывания (TIM4, приоритет выше всех писателей tx_ff): байт System Real-Time
+// сразу в tx_ff. Попал на запись главного цикла — уходит сразу после неё.
+// Endpoint взводит SOF (USB_TX_SOF_SYNC) или midi_out_flush(). false — потерян
+bool midi_out_realtime_isr(uint8_t status);
+// Из главного цикла: взвести IN endpoint данными, уже лежащими в tx_ff (без USB_TX_SOF_SYNC)
+void midi_out_flush();
+
+// Из главного цикла: отложенные CC по накопленным токенам, затем
+// очереди кабелей -> tx_ff по кругу, пока есть место
+void midi_out_schedule();
+// true — в очередях есть сообщения
+bool midi_out_pending();
+
+// 7 -> 16 бит по правилу MIDI 2.0 (min-center-max): 0 -> 0, 64 -> 0x8000, 127 -> 0xFFFF
+constexpr uint16_t midi_velocity16(uint8_t v7) {
+    uint32_t v = static_cast<uint32_t>(v7) << 9;
+    if (v7 > 64u) {
+        for (uint32_t rep = (v7 & 0x3Fu) << 3; rep != 0u; rep >>= 6) {
+            v |= rep;
+        }
+    }
+    return static_cast<uint16_t>(v);
+}
+
+static_assert(midi_velocity16(0u) == 0x0000u && midi_velocity16(64u) == 0x8000u &&
+              midi_velocity16(127u) == 0xFFFFu, "MIDI 2.0 velocity upscale");
@@ -1,4 +1,5 @@
 #include "pedal.hpp"
+#include "pedal_queue.hpp"
 
 using uint = unsigned int;
 using cuint = const uint;
@@ -7,81 +8,18 @@ static constexpr uint32_t LED_ON = GPIO_PIN_13;                  // BSRR set
 static constexpr uint32_t LED_OFF = GPIO_PIN_13 << 16u;           // BSRR reset
 static constexpr uint8_t RIGHT_ARROW = 0x4Fu;
 static constexpr uint8_t LEFT_ARROW = 0x50u;
+static constexpr bool HID_MEDIA_PEDALS = false; // true — педали C/D шлют Consumer Control вместо стрелок
 
 static constexpr uint32_t DEBOUNCE_TICKS = 800u;  // 80 мс  — антидребезг
 static constexpr uint32_t RELEASE_TICKS = 2000u;  // 200 мс — ожидание отпускания
 static constexpr uint32_t TIMEOUT_TICKS = 3000u;  // 300 мс — таймаут ложного срабатывания
 
 volatile int pwr_flag = 0;
-static volatile uint32_t  adc_raw = 0u;   // последнее сырое значение АЦП
-static volatile uint32_t  adc_prev = 0u;   // предыдущее значение (для гистерезиса)
-static volatile uint      cc_velocity_prev = 0u;  // флаг: АЦП инициализировано и готово
-static volatile uint8_t  cc_velocity = 0u; // значение velocity для midi
-
-static constexpr uint32_t  ADC_MIN = 300u; // подавление шума
-static constexpr uint32_t  ADC_HYSTERESIS = 14u; // +- гистерезис
-static constexpr uint8_t  MIDI_CC_SCALE = 30u;
-static constexpr uint8_t  MIDI_CC_OFFSET = 9u;
-static constexpr uint8_t  MIDI_CC_CHANNEL = 176u;   // 0xB0 — Control Change, канал 1
-static constexpr uint8_t  MIDI_CC_NUM = 64u;    // CC#64 — Sustain Pedal
+volatile int idle_timeout = 0;            // TIM2: простой, STOP/STANDBY из главного цикла
+
 static constexpr uint8_t  MIDI_NOTE_CH = 0x91u;  // Note On, канал 2
 static constexpr uint8_t  MIDI_CC_MAX = 127u;
 
-enum class pedal_type {
-    a = EXTI_IMR_MR0,
-    b = EXTI_IMR_MR1,
-    c = EXTI_IMR_MR2,
-    d = EXTI_IMR_MR3
-};
-
-enum class pedal_condition {
-    none = 0, worked, pressed, free
-};
-
-struct pedals {
-    pedal_type ped = pedal_type::a;
-    uint32_t time = 0u;
-    pedal_condition condition = pedal_condition::none;
-};
-
-static constexpr uint32_t RING_BUF_SIZE = 8u; // должно быть степенью 2 для быстрого вычисления остатка
-static_assert((RING_BUF_SIZE& (RING_BUF_SIZE - 1u)) == 0u, "RING_BUF_SIZE must be power of 2");
-
-struct RingBuf {
-    pedals buf[RING_BUF_SIZE] = {};
-    volatile uint32_t write_idx = 0u; // пишет только ISR
-    volatile uint32_t read_idx = 0u; // читает/пишет только main loop
-
-    void push(const pedals& item) {
-        uint32_t next = (write_idx + 1u) & (RING_BUF_SIZE - 1u);
-        if (next != read_idx) { // буфер не переполнен
-            buf[write_idx] = item;
-            // Барьер памяти: данные buf[] должны быть записаны ДО обновления write_idx,
-            // чтобы main loop не прочитал незаписанный элемент.
-            __DMB();
-            write_idx = next;
-        }
-        // Если буфер полон — событие теряется (защита от переполнения).
-    }
-
-    bool empty() const {
-        return read_idx == write_idx;
-    }
-
-    // Возвращает указатель на front-элемент (не удаляет).
-    // Вызывать только если !empty().
-    pedals& front() {
-        return buf[read_idx];
-    }
-
-    // Удаляет front-элемент. Вызывать только если !empty().
-    void pop_front() {
-        // Барьер памяти: убеждаемся, что мы закончили читать buf[] до сдвига read_idx.
-        __DMB();
-        read_idx = (read_idx + 1u) & (RING_BUF_SIZE - 1u);
-    }
-};
-
 static RingBuf vPedals;
 
 static inline void exti_enable(pedal_type ped) {
@@ -90,6 +28,11 @@ static inline void exti_enable(pedal_type ped) {
     __enable_irq();
 }
 
+// Клок и DIN работают от TIM4/USART1/DMA2: HCLK не снижать, в STOP не уходить
+static bool midi_busy() {
+    return midi_clock_busy() || midi_din_busy();
+}
+
 uint32_t timeLength(const uint& t1, const uint& t2) {
     uint32_t tOut;
     if (t1 > t2) {
@@ -103,19 +46,38 @@ uint32_t timeLength(const uint& t1, const uint& t2) {
 
 void pedal() {
 
+    pwr_init();
+    irq_priority_apply();
+#ifdef DEBUG
+    ll::check_config();
+#endif
     HAL_ADC_Start_IT(&hadc1);
-    HAL_TIM_Base_Start(&htim3);
-    HAL_Delay(15);
     pwr();
+    boot_mark(BOOT_STAGE_RTC);
+
+    // USB — сразу после снимка: хост начинает опрос с подтяжки D+,
+    // таймеры и остальное успевают, пока он выжидает 100 мс до сброса шины
+    // Педаль B зажата при включении — противоположный сборке USB-профиль
+    if (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_1) == GPIO_PIN_RESET) {
+        usb_profile_select(!USB_PROFILE_LOW_LATENCY);
+    }
+    board_init_usb();
+    tud_init(0);
+    boot_mark(BOOT_STAGE_USB);
+
+    HAL_TIM_Base_Start(&htim3);
     HAL_TIM_Base_Start(&htim5); // 100us
     HAL_TIM_Base_Start_IT(&htim2);
+    midi_clock_init();
+    midi_din_init();
+    trace_init();
     pwr_flag = 1;
     GPIOC->BSRR = LED_OFF;
 
-    board_init_usb();
-    tud_init(0);
-
     while (1) {
+        clk_governor(!vPedals.empty() || tud_task_event_ready() || midi_busy());
+        midi_clock_process(HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_3) == GPIO_PIN_RESET);
+        adc_process();
         if (!vPedals.empty()) {
             auto now = TIM5->CNT;
             auto& vP = vPedals.front();
@@ -126,28 +88,41 @@ void pedal() {
                 case pedal_type::a:
                     if (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_0) == GPIO_PIN_RESET) {
                         vP.condition = pedal_condition::pressed;
-                        MidiSender(60, 44);
+                        MidiSender(60, 44, vP.time);
                         GPIOC->BSRR = LED_ON;
                     }
                     break;
                 case pedal_type::b:
                     if (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_1) == GPIO_PIN_RESET) {
                         vP.condition = pedal_condition::pressed;
-                        MidiSender(61, 33);
+                        MidiSender(61, 33, vP.time);
                         GPIOC->BSRR = LED_ON;
                     }
                     break;
                 case pedal_type::c:
                     if (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_2) == GPIO_PIN_RESET) {
                         vP.condition = pedal_condition::pressed;
-                        KeySender(RIGHT_ARROW);
+                        if (HID_MEDIA_PEDALS) {
+                            ConsumerSender(HID_USAGE_CONSUMER_SCAN_NEXT);
+                        }
+                        else {
+                            KeySender(RIGHT_ARROW);
+                        }
                         GPIOC->BSRR = LED_ON;
                     }
                     break;
                 case pedal_type::d:
                     if (HAL_GPIO_ReadPin(GPIOA, GPIO_PIN_3) == GPIO_PIN_RESET) {
                         vP.condition = pedal_condition::pressed;
-                        KeySender(LEFT_ARROW);
+                        if (MIDI_CLOCK) {
+                            midi_clock_press(vP.time);
+                        }
+                        else if (HID_MEDIA_PEDALS) {
+                            ConsumerSender(HID_USAGE_CONSUMER_SCAN_PREVIOUS);
+                        }
+                        else {
+                            KeySender(LEFT_ARROW);
+                        }
                         GPIOC->BSRR = LED_ON;
                     }
                     break;
@@ -156,8 +131,13 @@ void pedal() {
 
             if (elapsed > RELEASE_TICKS && vP.condition == pedal_condition::pressed) {
                 exti_enable(vP.ped);
-                if (vP.ped == pedal_type::c || vP.ped == pedal_type::d) {
-                    tud_hid_keyboard_report(0, 0, NULL);
+                if (vP.ped == pedal_type::c || (vP.ped == pedal_type::d && !MIDI_CLOCK)) {
+                    if (HID_MEDIA_PEDALS) {
+                        hid_consumer_release();
+                    }
+                    else {
+                        hid_keyboard_release();
+                    }
                 }
                 vPedals.pop_front();
                 GPIOC->BSRR = LED_OFF;
@@ -170,63 +150,79 @@ void pedal() {
             }
         }
         tud_task();
+        midi_in_process();
+        midi_din_receive();
+        midi_out_schedule();
+        midi_din_process();
+#if !USB_TX_SOF_SYNC
+        hid_dispatch();
+#endif
+        boot_report();
+        diag_log_process();
+        trace_process();
+        pwr_idle([] { return !vPedals.empty(); }, midi_busy);
     }
 }
 
+#if HAL_IRQ_HANDLERS
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef* hadc) {
     if (pwr_flag && hadc->Instance == ADC1) {
-        adc_raw = HAL_ADC_GetValue(&hadc1);
-        if (adc_raw < ADC_MIN) {
-            adc_raw = ADC_MIN;
-        }
-        if (adc_raw - adc_prev > ADC_HYSTERESIS || adc_prev - adc_raw > ADC_HYSTERESIS) {
-            cc_velocity = adc_raw / MIDI_CC_SCALE - MIDI_CC_OFFSET;
-            if (cc_velocity != cc_velocity_prev) {
-                uint8_t note_on[3] = { MIDI_CC_CHANNEL, MIDI_CC_NUM, cc_velocity };
-                tud_midi_stream_write(0, note_on, sizeof(note_on));
-                cc_velocity_prev = cc_velocity;
-                TIM2->CNT = 0;
-            }
-            adc_prev = adc_raw;
-        }
+        adc_sample_isr(static_cast<uint16_t>(HAL_ADC_GetValue(hadc)));
     }
 }
+#endif
 
-void MidiSender(const uint8_t note, const uint8_t velocity) {
-    uint8_t note_on[3] = { MIDI_NOTE_CH, note, velocity };
-    tud_midi_stream_write(0, note_on, sizeof(note_on));
+void MidiSender(const uint8_t note, const uint8_t velocity, const uint32_t time) {
+    midi_note_on(midi_cable::pedals, MIDI_NOTE_CH, static_cast<uint8_t>(note + midi_in_note_offset()), midi_velocity16(velocity), time);
+    LOG("pedal: note %u vel %u, edge at %u", note, velocity, time);
     TIM2->CNT = 0;
+    pwr_note_event();
 }
 
 void KeySender(const uint8_t command) {
-    if (tud_hid_ready()) {
-        uint8_t keycode[6] = { command, 0, 0, 0, 0, 0 };
-        tud_hid_keyboard_report(0, 0, keycode);
-    }
+    hid_keyboard_press(command);
+    pwr_note_event();
+}
+
+void ConsumerSender(const uint16_t usage) {
+    hid_consumer_press(usage);
+    pwr_note_event();
 }
 
 extern "C" {
     void EXTI0_IRQHandler(void) { // disable "IRQHandlers" in stm32f4xx_it.c
+        ISR_PROFILE_ENTER();
         EXTI->PR = EXTI_PR_PR0;
         EXTI->IMR &= ~EXTI_IMR_MR0;
         vPedals.push({ pedal_type::a, TIM5->CNT, pedal_condition::worked });
+        TRACE("exti: pedal A edge");
+        ISR_PROFILE_EXIT(ISR_ID_EXTI);
     }
 
     void EXTI1_IRQHandler(void) {
+        ISR_PROFILE_ENTER();
         EXTI->PR = EXTI_PR_PR1;
         EXTI->IMR &= ~EXTI_IMR_MR1;
         vPedals.push({ pedal_type::b, TIM5->CNT, pedal_condition::worked });
+        TRACE("exti: pedal B edge");
+        ISR_PROFILE_EXIT(ISR_ID_EXTI);
     }
 
     void EXTI2_IRQHandler(void) {
+        ISR_PROFILE_ENTER();
         EXTI->PR = EXTI_PR_PR2;
         EXTI->IMR &= ~EXTI_IMR_MR2;
         vPedals.push({ pedal_type::c, TIM5->CNT, pedal_condition::worked });
+        TRACE("exti: pedal C edge");
+        ISR_PROFILE_EXIT(ISR_ID_EXTI);
     }
 
     void EXTI3_IRQHandler(void) {
+        ISR_PROFILE_ENTER();
         EXTI->PR = EXTI_PR_PR3;
         EXTI->IMR &= ~EXTI_IMR_MR3;
         vPedals.push({ pedal_type::d, TIM5->CNT, pedal_condition::worked });
+        TRACE("exti: pedal D edge");
+        ISR_PROFILE_EXIT(ISR_ID_EXTI);
     }
 }
@@ -8,15 +8,30 @@
 #include "tusb.h"
 #include "board_api.h"
 #include "power.h"
+#include "hid_reports.hpp"
+#include "adc_input.hpp"
+#include "isr_profile.h"
+#include "boot_profile.h"
+#include "irq_priority.h"
+#include "ll_periph.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
     void pedal();
-    void MidiSender(const uint8_t note, const uint8_t velocity);
+    void MidiSender(const uint8_t note, const uint8_t velocity, const uint32_t time); // time — метка EXTI (TIM5)
     void KeySender(const uint8_t command);
+    void ConsumerSender(const uint16_t usage);
 
 #ifdef __cplusplus
 }
+
+#include "clock_gov.hpp"
+#include "midi_out.hpp"
+#include "midi_in.hpp"
+#include "midi_clock.hpp"
+#include "midi_din.hpp"
+#include "diag_log.hpp"
+#include "trace.hpp"
 #endif
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+// Очередь нажатий EXTI -> главный цикл. Без обращений к периферии: собирается и в tests/.
+
+enum class pedal_type {
+    a = EXTI_IMR_MR0,
+    b = EXTI_IMR_MR1,
+    c = EXTI_IMR_MR2,
+    d = EXTI_IMR_MR3
+};
+
+enum class pedal_condition {
+    none = 0, worked, pressed, free
+};
+
+struct pedals {
+    pedal_type ped = pedal_type::a;
+    uint32_t time = 0u;
+    pedal_condition condition = pedal_condition::none;
+};
+
+static constexpr uint32_t RING_BUF_SIZE = 8u; // должно быть степенью 2 для быстрого вычисления остатка
+static_assert((RING_BUF_SIZE& (RING_BUF_SIZE - 1u)) == 0u, "RING_BUF_SIZE must be power of 2");
+
+struct RingBuf {
+    pedals buf[RING_BUF_SIZE] = {};
+    volatile uint32_t write_idx = 0u; // пишет только ISR
+    volatile uint32_t read_idx = 0u; // читает/пишет только main loop
+
+    void push(const pedals& item) {
+        uint32_t next = (write_idx + 1u) & (RING_BUF_SIZE - 1u);
+        if (next != read_idx) { // буфер не переполнен
+            buf[write_idx] = item;
+            // Барьер памяти: данные buf[] должны быть записаны ДО обновления write_idx,
+            // чтобы main loop не прочитал незаписанный элемент.
+            __DMB();
+            write_idx = next;
+        }
+        // Если буфер полон — событие теряется (защита от переполнения).
+    }
+
+    bool empty() const {
+        return read_idx == write_idx;
+    }
+
+    // Возвращает указатель на front-элемент (не удаляет).
+    // Вызывать только если !empty().
+    pedals& front() {
+        return buf[read_idx];
+    }
+
+    // Удаляет front-элемент. Вызывать только если !empty().
+    void pop_front() {
+        // Барьер памяти: убеждаемся, что мы закончили читать buf[] до сдвига read_idx.
+        __DMB();
+        read_idx = (read_idx + 1u) & (RING_BUF_SIZE - 1u);
+    }
+};
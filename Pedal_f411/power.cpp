@@ -5,25 +5,264 @@
  *      Author: sche
  */
 #include "stm32f4xx_hal.h"
-extern ADC_HandleTypeDef hadc1;
+#include "power.h"
+#include "rtc.h"
+#include "tusb.h"
+#include "adc_input.hpp"
+#include "isr_profile.h"
+#include "boot_profile.h"
+#include "clock_gov.hpp"
+#include "snapshot.hpp"
+#include "diag_log.hpp"
+#include "ll_periph.h"
+#include "midi_din.hpp"
+extern "C" void SystemClock_Config(void);
 
-void pwr() {
+static constexpr uint32_t WAKE_BURST = 9u;          // отсчётов в серии, нечётное — медиана без усреднения
+static constexpr uint32_t WAKE_BURSTS_MAX = 3u;     // серий, пока медиана между порогами
+static constexpr uint32_t WAKE_RETRY_MS = 1u;
+static constexpr uint16_t WAKE_ADC_ON = 2200u;      // выше — педаль нажата, загрузка
+static constexpr uint16_t WAKE_ADC_OFF = 1800u;     // ниже — помеха на WKUP, обратно в STANDBY
+static constexpr uint16_t WAKE_ADC_MID = 2000u;     // прежний порог: решает, если все серии между порогами
+
+static void enter_standby() {
+	HAL_PWR_DisableWakeUpPin(PWR_WAKEUP_PIN1);
+	__HAL_PWR_CLEAR_FLAG(PWR_FLAG_SB);
+	__HAL_PWR_CLEAR_FLAG(PWR_FLAG_WU);
+	HAL_PWR_EnableWakeUpPin(PWR_WAKEUP_PIN1);
+	HAL_PWR_EnterSTANDBYMode();
+}
+
+static uint16_t median(uint16_t* v, uint32_t n) {
+	for (uint32_t i = 1u; i < n; ++i) {
+		const uint16_t x = v[i];
+		uint32_t j = i;
+		for (; j > 0u && v[j - 1u] > x; --j) {
+			v[j] = v[j - 1u];
+		}
+		v[j] = x;
+	}
+	return v[n / 2u];
+}
 
+// Сразу после HAL_Init, ядро на HSI 16 МГц: HSE, PLL и периферия ещё не запущены,
+// поэтому ложное пробуждение возвращается в STANDBY за десятки мкс
+void pwr_wake_qualify() {
 	if (!__HAL_PWR_GET_FLAG(PWR_FLAG_SB)) {
-		HAL_PWR_DisableWakeUpPin(PWR_WAKEUP_PIN1);
-		__HAL_PWR_CLEAR_FLAG(PWR_FLAG_SB);
-		HAL_PWR_EnableWakeUpPin(PWR_WAKEUP_PIN1);
-		HAL_PWR_EnterSTANDBYMode();
-	} else {
-		HAL_PWR_DisableWakeUpPin(PWR_WAKEUP_PIN1);
-		int val = HAL_ADC_GetValue(&hadc1);
-		if (val > 2000) {
-		} else {
-			__HAL_PWR_CLEAR_FLAG(PWR_FLAG_WU);
-			HAL_PWR_DisableWakeUpPin(PWR_WAKEUP_PIN1);
-			__HAL_PWR_CLEAR_FLAG(PWR_FLAG_SB);
-			HAL_PWR_EnableWakeUpPin(PWR_WAKEUP_PIN1);
-			HAL_PWR_EnterSTANDBYMode();
+		wake_log(wake_reason::cold, 0u, 0u);
+		enter_standby();
+	}
+	uint16_t burst[WAKE_BURST];
+	uint16_t level = 0u;
+	uint32_t bursts = 0u;
+	for (;;) {
+		ll::adc_burst(burst, WAKE_BURST);
+		level = median(burst, WAKE_BURST);
+		if (++bursts == WAKE_BURSTS_MAX || level > WAKE_ADC_ON || level < WAKE_ADC_OFF) {
+			break;
+		}
+		HAL_Delay(WAKE_RETRY_MS);
+	}
+	if (level > WAKE_ADC_MID) {
+		wake_log(wake_reason::pedal, level, bursts);
+		return;
+	}
+	wake_log(wake_reason::noise, level, bursts);
+	enter_standby();
+}
+
+void pwr() {
+	HAL_PWR_DisableWakeUpPin(PWR_WAKEUP_PIN1);
+	snapshot_restore(); // sustain и ожидающие нажатия — как перед STANDBY
+}
+
+// Уход в STANDBY по таймауту простоя; вызывается из главного цикла
+void pwr_standby() {
+	snapshot_save();
+	enter_standby();
+}
+
+static constexpr uint32_t PWR_RTC_WAKE_S = 10u;               // RTC будит STOP раз в 10 с — счёт времени сна
+static constexpr uint32_t PWR_STANDBY_AFTER_S = 20u * 60u;    // столько в STOP без событий — и в STANDBY
+static constexpr uint32_t EXTI_OTG_FS_WKUP = EXTI_IMR_MR18;   // resume хоста в STOP
+
+volatile pwr_wake_stats_t pwr_stats[static_cast<uint8_t>(pwr_state::count)];
+
+static constexpr uint32_t REMOTE_WAKEUP_HOLD_TICKS = 10000u;  // 1 с ждём resume хоста, не уходя в STOP
+
+static volatile bool rtc_woke = false;
+static volatile bool usb_woke = false;
+static pwr_state wake_state = pwr_state::sleep;
+static uint32_t wake_tick = 0u;     // TIM5 в момент пробуждения
+static bool wake_armed = false;     // ждём первое событие после пробуждения
+static bool remote_wakeup_en = false;   // хост разрешил remote wakeup (SET_FEATURE)
+static bool wakeup_requested = false;   // послали resume, ждём хост
+static uint32_t wakeup_tick = 0u;
+static uint32_t awake_since = 0u;       // DWT: выход из последнего WFI / STOP
+
+void pwr_init() {
+	isr_profile_init(); // DWT->CYCCNT: замер выхода из сна
+	MX_RTC_Init();
+	HAL_RTCEx_DeactivateWakeUpTimer(&hrtc); // RTC будит только из STOP
+}
+
+// Событие во время suspend: будим хост. Само сообщение остаётся в очереди
+// (tx_ff MIDI, очередь HID) и уходит после resume
+static void request_wakeup() {
+	if (remote_wakeup_en && !wakeup_requested && tud_remote_wakeup()) {
+		wakeup_requested = true;
+		wakeup_tick = TIM5->CNT;
+	}
+}
+
+void pwr_note_event() {
+	if (tud_suspended()) {
+		request_wakeup();
+	}
+	if (tud_mounted()) {
+		boot_mark(BOOT_STAGE_FIRST_EVENT); // до подключения сообщения стек отбрасывает
+	}
+	if (wake_armed) {
+		wake_armed = false;
+		const uint32_t dt = TIM5->CNT - wake_tick;
+		auto& s = pwr_stats[static_cast<uint8_t>(wake_state)];
+		if (dt > s.first_event_max) {
+			s.first_event_max = dt;
 		}
 	}
 }
+
+static void wake_done(pwr_state state, uint32_t t_wfi) {
+	const uint32_t dt = DWT->CYCCNT - t_wfi;
+	auto& s = pwr_stats[static_cast<uint8_t>(state)];
+	s.count = s.count + 1u;
+	if (dt > s.resume_cycles_max) {
+		s.resume_cycles_max = dt;
+	}
+	wake_state = state;
+	wake_tick = TIM5->CNT;
+	wake_armed = true;
+}
+
+// STOP до события: педаль, resume хоста, байт на DIN MIDI IN или истечение PWR_STANDBY_AFTER_S.
+// Пробуждения только по RTC обслуживаются на HSI, без подъёма PLL.
+static void enter_stop(pwr_state state, bool (*work_pending)()) {
+	HAL_SuspendTick();
+	ADC1->CR2 &= ~ADC_CR2_ADON; // аналоговая часть АЦП ~1.6 мА — не влезает в 2.5 мА suspend
+	EXTI->PR = EXTI_OTG_FS_WKUP;
+	EXTI->RTSR |= EXTI_OTG_FS_WKUP;
+	EXTI->IMR |= EXTI_OTG_FS_WKUP;
+	HAL_NVIC_EnableIRQ(OTG_FS_WKUP_IRQn);
+	midi_din_wake_arm();
+	HAL_RTCEx_SetWakeUpTimer_IT(&hrtc, PWR_RTC_WAKE_S - 1u, RTC_WAKEUPCLOCK_CK_SPRE_16BITS);
+
+	uint32_t stopped_s = 0u;
+	uint32_t t_wfi = 0u;
+	usb_woke = false;
+	for (;;) {
+		__disable_irq();
+		if (work_pending() || usb_woke || tud_task_event_ready()) {
+			__enable_irq();
+			break;
+		}
+		rtc_woke = false;
+		HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+		t_wfi = DWT->CYCCNT;
+		__enable_irq(); // здесь отрабатывают разбудившие прерывания (ещё на HSI)
+		if (!rtc_woke) {
+			break;
+		}
+		stopped_s += PWR_RTC_WAKE_S;
+		// RTC мог совпасть с нажатием: нажатие в снимок не входит — сначала его обработать
+		if (stopped_s >= PWR_STANDBY_AFTER_S && !work_pending()) {
+			tud_disconnect();
+			pwr_standby();
+		}
+	}
+
+	HAL_RTCEx_DeactivateWakeUpTimer(&hrtc);
+	HAL_NVIC_DisableIRQ(OTG_FS_WKUP_IRQn);
+	EXTI->IMR &= ~EXTI_OTG_FS_WKUP;
+	midi_din_wake_disarm();
+	SystemClock_Config(); // HSE + PLL: SYSCLK 96 МГц, USB 48 МГц
+	clk_resync();         // регулятор мог оставить таймеры под 24 МГц
+	HAL_ResumeTick();
+	ADC1->CR2 |= ADC_CR2_ADON; // tSTAB 3 мкс, первый TRGO через <= 8 мс
+	if (state == pwr_state::stop_detached) {
+		tud_connect();
+	}
+	wake_done(state, t_wfi);
+}
+
+void pwr_idle(bool (*work_pending)(), bool (*stop_blocked)()) {
+	const bool keep_running = stop_blocked();
+	if (idle_timeout && keep_running) {
+		idle_timeout = 0; // клок или DIN — тоже работа: отсчёт простоя заново
+		TIM2->CNT = 0;
+	}
+	if (idle_timeout) {
+		tud_disconnect();
+		clk_awake(DWT->CYCCNT - awake_since);
+		enter_stop(pwr_state::stop_detached, work_pending);
+		awake_since = DWT->CYCCNT;
+		idle_timeout = 0;
+		TIM2->CNT = 0;
+		return;
+	}
+	if (wakeup_requested && TIM5->CNT - wakeup_tick > REMOTE_WAKEUP_HOLD_TICKS) {
+		wakeup_requested = false; // хост не ответил — можно снова в STOP и повторить позже
+	}
+	if (tud_suspended() && !wakeup_requested && !keep_running) {
+		clk_awake(DWT->CYCCNT - awake_since);
+		enter_stop(pwr_state::stop, work_pending);
+		awake_since = DWT->CYCCNT;
+		return;
+	}
+
+	// Прерывание между проверкой и WFI не теряется: WFI выходит по ожидающему
+	// прерыванию и при PRIMASK = 1
+	__disable_irq();
+	if (!work_pending() && !tud_task_event_ready() && !adc_pending()) {
+		clk_awake(DWT->CYCCNT - awake_since);
+		__WFI();
+		const uint32_t t_wfi = DWT->CYCCNT;
+		awake_since = t_wfi;
+		__enable_irq();
+		// SOF, АЦП и таймеры будят WFI каждую миллисекунду — в статистику ступени
+		// только выходы по нажатию, иначе first_event_max мерил бы время от последнего тика
+		if (work_pending()) {
+			wake_done(pwr_state::sleep, t_wfi);
+		}
+		return;
+	}
+	__enable_irq();
+}
+
+extern "C" {
+	// Invoked when usb bus is suspended
+	// remote_wakeup_en : if host allow us to perform remote wakeup
+	// Within 7ms, device must draw an average of current less than 2.5 mA from bus:
+	// pwr_idle() на следующем проходе главного цикла (< 1 мс) уводит MCU в STOP
+	void tud_suspend_cb(bool en) {
+		remote_wakeup_en = en;
+		wakeup_requested = false;
+		GPIOC->BSRR = GPIO_PIN_13 << 16u; // LED off
+		LOG("usb: suspend, remote wakeup %u", en);
+	}
+
+	// Invoked when usb bus is resumed
+	void tud_resume_cb(void) {
+		wakeup_requested = false;
+		LOG("usb: resume");
+	}
+
+	void HAL_RTCEx_WakeUpTimerEventCallback(RTC_HandleTypeDef* hrtc) {
+		(void)hrtc;
+		rtc_woke = true;
+	}
+
+	void OTG_FS_WKUP_IRQHandler(void) {
+		EXTI->PR = EXTI_OTG_FS_WKUP;
+		usb_woke = true;
+	}
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+#include "stm32f4xx.h"
+
+// Кольцо двоичных записей для журнала (diag_log.hpp) и трассировки (trace.hpp).
+// Пишет кто угодно, включая прерывания любого приоритета; читает только главный цикл.
+//
+// Место резервируется LDREX/STREX на write_idx, заголовок пишется последним: пока
+// в нём нет бита готовности, читатель ждёт, даже если за записью уже лежат более
+// поздние (вытеснивший писатель). Читатель обнуляет прочитанное до сдвига read_idx,
+// поэтому свободный слот всегда 0. Кольцо полно — запись теряется (dropped), ждать некому.
+//
+// Запись, слова little-endian — в кольце и на проводе одинаково:
+//   [0] bit 31 — запись готова, [27:24] — число аргументов, [23:0] — id строки формата
+//       (LOST_ID кольца — служебная запись «потеряно N», N в аргументе: у журнала 0,
+//       у трассировки 0x800000 — оба кольца сливаются в один CDC-поток, и хост по id
+//       знает, чьи записи пропали и в чём метка)
+//   [1] метка времени: TIM5 у журнала, DWT->CYCCNT у трассировки
+//   [2..] аргументы, uint32_t
+
+static constexpr uint32_t REC_HEAD_READY = 1u << 31;
+static constexpr uint32_t REC_ID_MASK = 0x00FFFFFFu;
+static constexpr uint32_t REC_ARGS_MAX = 4u;
+static constexpr uint32_t REC_WORDS_MAX = 2u + REC_ARGS_MAX;
+// Id потерь: на единицу ниже начала таблицы строк кольца (STM32F411XX_FLASH.ld)
+static constexpr uint32_t REC_LOST_LOG = 0u;
+static constexpr uint32_t REC_LOST_TRACE = 0x800000u;
+
+constexpr uint32_t rec_head(uint32_t id, uint32_t nargs) {
+    return REC_HEAD_READY | (nargs << 24) | (id & REC_ID_MASK);
+}
+
+template <uint32_t WORDS, uint32_t LOST_ID>
+struct rec_ring {
+    static_assert((WORDS & (WORDS - 1u)) == 0u, "rec_ring size must be power of 2");
+    static_assert((LOST_ID & ~REC_ID_MASK) == 0u, "rec_ring loss id must fit the id field");
+
+    volatile uint32_t buf[WORDS];
+    volatile uint32_t write_idx;
+    volatile uint32_t read_idx;
+    volatile uint32_t dropped;
+
+    // Встраивается в точку вызова: без вызова функции и без запрета прерываний
+    __attribute__((always_inline)) bool put(uint32_t id, uint32_t time, const uint32_t* args, uint32_t nargs) {
+        const uint32_t n = 2u + nargs;
+        uint32_t w;
+        do {
+            w = __LDREXW(&write_idx);
+            if (w + n - read_idx > WORDS) {
+                __CLREX();
+                uint32_t d;
+                do {
+                    d = __LDREXW(&dropped);
+                } while (__STREXW(d + 1u, &dropped) != 0u);
+                return false;
+            }
+        } while (__STREXW(w + n, &write_idx) != 0u);
+
+        buf[(w + 1u) & (WORDS - 1u)] = time;
+        for (uint32_t i = 0u; i < nargs; ++i) {
+            buf[(w + 2u + i) & (WORDS - 1u)] = args[i];
+        }
+        __DMB();
+        buf[w & (WORDS - 1u)] = rec_head(id, nargs); // запись видна читателю целиком
+        return true;
+    }
+
+    // Следующая готовая запись в out[0..n); false — пусто или первая ещё пишется
+    bool take(uint32_t* out, uint32_t& n) {
+        const uint32_t r = read_idx;
+        if (r == write_idx) {
+            return false;
+        }
+        const uint32_t h = buf[r & (WORDS - 1u)];
+        if ((h & REC_HEAD_READY) == 0u) {
+            return false;
+        }
+        n = 2u + ((h >> 24) & 0x7Fu);
+        for (uint32_t i = 0u; i < n; ++i) {
+            out[i] = buf[(r + i) & (WORDS - 1u)];
+            buf[(r + i) & (WORDS - 1u)] = 0u;
+        }
+        __DMB();
+        read_idx = r + n;
+        return true;
+    }
+
+    // Как take(), но сначала — служебная запись о потерях с прошлого вызова.
+    // reported — сколько потерь уже отдано хосту, хранит вызывающий
+    bool next(uint32_t& reported, uint32_t time, uint32_t* out, uint32_t& n) {
+        const uint32_t d = dropped;
+        if (d != reported) {
+            out[0] = rec_head(LOST_ID, 1u);
+            out[1] = time;
+            out[2] = d - reported;
+            n = 3u;
+            reported = d;
+            return true;
+        }
+        return take(out, n);
+    }
+
+    // Только главный цикл, при запрещённых прерываниях: сброс после калибровки
+    void clear() {
+        for (uint32_t i = 0u; i < WORDS; ++i) {
+            buf[i] = 0u;
+        }
+        write_idx = 0u;
+        read_idx = 0u;
+    }
+};
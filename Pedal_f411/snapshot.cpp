@@ -0,0 +1,55 @@
+#include "snapshot.hpp"
+#include "main.h"
+#include "adc_input.hpp"
+
+persist_stats_t persist_stats;
+
+static volatile uint32_t* bkp(bkp_reg r) {
+    return &RTC->BKP0R + r;
+}
+
+void snapshot_save() {
+    snapshot_t s;
+    s.adc = adc_state_pack();
+    s.standby_count = persist_stats.standby_count + 1u;
+    s.adc_overruns = persist_stats.adc_overruns + adc_overruns();
+    uint32_t regs[SNAPSHOT_REGS];
+    snapshot_pack(s, regs);
+
+    HAL_PWR_EnableBkUpAccess();
+    for (uint8_t r = 0u; r < SNAPSHOT_REGS; ++r) {
+        *bkp(static_cast<bkp_reg>(r)) = regs[r];
+    }
+}
+
+void wake_log(wake_reason reason, uint16_t adc_median, uint32_t bursts) {
+    HAL_PWR_EnableBkUpAccess();
+    const auto r = static_cast<uint8_t>(reason);
+    persist_stats.wake_last = r | (static_cast<uint32_t>(adc_median) << 8) | (bursts << 24);
+    *bkp(BKP_WAKE_LAST) = persist_stats.wake_last;
+    for (uint8_t i = 0u; i < static_cast<uint8_t>(wake_reason::count); ++i) {
+        persist_stats.wakes[i] = *bkp(static_cast<bkp_reg>(BKP_WAKE_COUNT + i));
+    }
+    persist_stats.wakes[r] += 1u;
+    *bkp(static_cast<bkp_reg>(BKP_WAKE_COUNT + r)) = persist_stats.wakes[r];
+}
+
+bool snapshot_restore() {
+    persist_stats.restored = false;
+    uint32_t regs[SNAPSHOT_REGS];
+    for (uint8_t r = 0u; r < SNAPSHOT_REGS; ++r) {
+        regs[r] = *bkp(static_cast<bkp_reg>(r));
+    }
+    snapshot_t s;
+    if (!snapshot_unpack(regs, s)) {
+        return false; // холодный старт или снимок испорчен — начинаем с нуля
+    }
+    persist_stats.standby_count = s.standby_count;
+    persist_stats.adc_overruns = s.adc_overruns;
+    adc_state_unpack(s.adc);
+
+    HAL_PWR_EnableBkUpAccess();
+    *bkp(BKP_MAGIC) = 0u; // снимок одноразовый: после сброса по питанию не применяется
+    persist_stats.restored = true;
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+
+// Снимок состояния в backup-регистрах RTC (RTC_BKP0R..BKP19R, 80 байт; backup SRAM
+// у F411 нет). Пишется перед STANDBY, читается в pwr() после пробуждения:
+// педаль продолжает с тем же значением sustain и не шлёт его повторно.
+// Очереди нажатий в снимке нет: в STANDBY уходят только из STOP, а STOP не
+// начинается и STANDBY не наступает, пока очередь не пуста (enter_stop()).
+
+// Причина сброса, по которому прошла pwr_wake_qualify()
+enum class wake_reason : uint8_t {
+    cold = 0,   // питание или NRST, не из STANDBY — сразу в STANDBY
+    pedal,      // медиана АЦП выше порога — загрузка
+    noise,      // ложное пробуждение — обратно в STANDBY
+    count
+};
+
+// Раскладка регистров
+enum bkp_reg : uint8_t {
+    BKP_MAGIC = 0,      // SNAPSHOT_MAGIC, если снимок записан
+    BKP_ADC,            // cc_velocity_prev [7:0], adc_prev [23:8]
+    BKP_STANDBY_COUNT,  // уходов в STANDBY за всё время
+    BKP_ADC_OVERRUNS,   // потерянных отсчётов АЦП, накопительно
+    BKP_CHECKSUM,       // XOR BKP_MAGIC..BKP_ADC_OVERRUNS
+    // Диагностика пробуждений: вне снимка и контрольной суммы, пишется при каждом сбросе
+    BKP_WAKE_LAST,      // причина [7:0], медиана АЦП [23:8], число серий [31:24]
+    BKP_WAKE_COUNT,     // счётчики по причинам: BKP_WAKE_COUNT + wake_reason
+    BKP_FREE = BKP_WAKE_COUNT + static_cast<uint8_t>(wake_reason::count)
+};
+
+static constexpr uint32_t SNAPSHOT_MAGIC = 0x50454432u; // "PED2", сменить при изменении раскладки
+static constexpr uint8_t SNAPSHOT_REGS = BKP_CHECKSUM + 1u; // BKP_MAGIC..BKP_CHECKSUM
+
+// Содержимое снимка; в регистры — snapshot_pack(), обратно — snapshot_unpack().
+// Без обращений к RTC: собирается и в tests/.
+struct snapshot_t {
+    uint32_t adc;           // adc_state_pack()
+    uint32_t standby_count;
+    uint32_t adc_overruns;
+};
+
+inline uint32_t snapshot_checksum(const uint32_t (&regs)[SNAPSHOT_REGS]) {
+    uint32_t x = 0u;
+    for (uint8_t r = BKP_MAGIC; r < BKP_CHECKSUM; ++r) {
+        x ^= regs[r];
+    }
+    return x;
+}
+
+inline void snapshot_pack(const snapshot_t& s, uint32_t (&regs)[SNAPSHOT_REGS]) {
+    regs[BKP_MAGIC] = SNAPSHOT_MAGIC;
+    regs[BKP_ADC] = s.adc;
+    regs[BKP_STANDBY_COUNT] = s.standby_count;
+    regs[BKP_ADC_OVERRUNS] = s.adc_overruns;
+    regs[BKP_CHECKSUM] = snapshot_checksum(regs);
+}
+
+// false — снимка нет (холодный старт) или он испорчен; s не меняется
+inline bool snapshot_unpack(const uint32_t (&regs)[SNAPSHOT_REGS], snapshot_t& s) {
+    if (regs[BKP_MAGIC] != SNAPSHOT_MAGIC || regs[BKP_CHECKSUM] != snapshot_checksum(regs)) {
+        return false;
+    }
+    s.adc = regs[BKP_ADC];
+    s.standby_count = regs[BKP_STANDBY_COUNT];
+    s.adc_overruns = regs[BKP_ADC_OVERRUNS];
+    return true;
+}
+
+// Накопительная статистика, переживает STANDBY (Live Watch)
+struct persist_stats_t {
+    uint32_t standby_count;
+    uint32_t adc_overruns;
+    bool restored;          // последнее пробуждение подхватило снимок
+    uint32_t wake_last;     // копия BKP_WAKE_LAST
+    uint32_t wakes[static_cast<uint8_t>(wake_reason::count)]; // сбросов по причинам; noise — ложные
+};
+
+extern persist_stats_t persist_stats;
+
+void snapshot_save();
+// true — снимок был и применён; снимок стирается, повторно не применяется
+bool snapshot_restore();
+// Из pwr_wake_qualify(), до MX_RTC_Init: учёт причины в backup-регистрах
+void wake_log(wake_reason reason, uint16_t adc_median, uint32_t bursts);
@@ -0,0 +1,125 @@
+#include "trace.hpp"
+#include "midi_out.hpp"
+#include "tusb.h"
+
+rec_ring<TRACE_RING_WORDS, REC_LOST_TRACE> trace_ring;
+trace_stats_t trace_stats;
+volatile trace_cycles_t trace_cycles;
+
+#if ISR_TRACE
+
+static constexpr uint32_t TRACE_CALIBRATE_RUNS = 8u;
+static constexpr uint32_t SWO_RECORDS_PER_PASS = 8u;   // ~1 мс порта на 2 Мбит/с — цикл не стоит дольше
+static constexpr uint8_t SYSEX_ID_NONCOMMERCIAL = 0x7Du;
+static constexpr uint8_t SYSEX_TRACE = 0x03u;
+static constexpr uint32_t SYSEX_LEN_MAX = 3u + 5u * REC_WORDS_MAX + 1u;
+static constexpr uint32_t SYSEX_PACKETS_MAX = (SYSEX_LEN_MAX + 2u) / 3u; // USB-MIDI 1.0; UMP берёт меньше
+
+static uint32_t dropped_reported = 0u;
+
+// Лучший из замеров: прерывания запрещены, кольцо пустое — чистая цена точки
+template <typename F>
+static uint32_t calibrate(F&& point) {
+    uint32_t best = UINT32_MAX;
+    for (uint32_t i = 0u; i < TRACE_CALIBRATE_RUNS; ++i) {
+        const uint32_t t0 = DWT->CYCCNT;
+        point();
+        const uint32_t dt = DWT->CYCCNT - t0;
+        best = dt < best ? dt : best;
+    }
+    return best;
+}
+
+void trace_init() {
+    // Метки — CYCCNT: без DBG_SLEEP такт ядра в WFI стоит, и время сна выпадает из меток.
+    // Цена — ток ядра во сне, для отладочной сборки допустимо
+    DBGMCU->CR |= DBGMCU_CR_DBG_SLEEP;
+    const uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    trace_stats.cost_cycles[0] = calibrate([] { TRACE("trace: calibrate"); });
+    trace_stats.cost_cycles[1] = calibrate([] { TRACE("trace: calibrate %u", 1u); });
+    trace_stats.cost_cycles[2] = calibrate([] { TRACE("trace: calibrate %u %u", 1u, 2u); });
+    trace_stats.cost_cycles[3] = calibrate([] { TRACE("trace: calibrate %u %u %u", 1u, 2u, 3u); });
+    trace_stats.cost_cycles[4] = calibrate([] { TRACE("trace: calibrate %u %u %u %u", 1u, 2u, 3u, 4u); });
+    trace_ring.clear();
+    __set_PRIMASK(primask);
+    TRACE("trace: point costs %u cycles, %u with 2 args, %u with 4 args",
+          trace_stats.cost_cycles[0], trace_stats.cost_cycles[2], trace_stats.cost_cycles[4]);
+}
+
+static bool swo_ready() {
+    return (ITM->TCR & ITM_TCR_ITMENA_Msk) != 0u && (ITM->TER & (1u << TRACE_ITM_PORT)) != 0u;
+}
+
+static void drain_swo() {
+    uint32_t rec[REC_WORDS_MAX];
+    uint32_t n;
+    for (uint32_t k = 0u; k < SWO_RECORDS_PER_PASS && trace_ring.next(dropped_reported, DWT->CYCCNT, rec, n); ++k) {
+        for (uint32_t i = 0u; i < n; ++i) {
+            while (ITM->PORT[TRACE_ITM_PORT].u32 == 0u) {
+            }
+            ITM->PORT[TRACE_ITM_PORT].u32 = rec[i];
+        }
+        trace_stats.swo++;
+    }
+}
+
+#if USB_CDC_CONSOLE
+static bool drain_cdc() {
+    if (!tud_cdc_connected()) {
+        return false;
+    }
+    uint32_t rec[REC_WORDS_MAX];
+    uint32_t n;
+    bool wrote = false;
+    while (tud_cdc_write_available() >= sizeof(rec) && trace_ring.next(dropped_reported, DWT->CYCCNT, rec, n)) {
+        tud_cdc_write(rec, n * sizeof(uint32_t));
+        trace_stats.cdc++;
+        wrote = true;
+    }
+    if (wrote) {
+        tud_cdc_write_flush();
+    }
+    return true;
+}
+#endif
+
+// Одна запись — одно сообщение: потерянный пакет SysEx не сбивает разбор следующих
+static void drain_sysex() {
+    if (!tud_midi_mounted()) {
+        return;
+    }
+    uint32_t rec[REC_WORDS_MAX];
+    uint32_t n;
+    while (!midi_sysex_pending(midi_cable::diag) && midi_out_free(midi_cable::diag) >= SYSEX_PACKETS_MAX &&
+           trace_ring.next(dropped_reported, DWT->CYCCNT, rec, n)) {
+        uint8_t msg[SYSEX_LEN_MAX];
+        uint32_t len = 0u;
+        msg[len++] = 0xF0u;
+        msg[len++] = SYSEX_ID_NONCOMMERCIAL;
+        msg[len++] = SYSEX_TRACE;
+        for (uint32_t i = 0u; i < n; ++i) {
+            for (uint32_t s = 0u; s < 32u; s += 7u) {
+                msg[len++] = (rec[i] >> s) & 0x7Fu;
+            }
+        }
+        msg[len++] = 0xF7u;
+        midi_sysex(midi_cable::diag, msg, len);
+        trace_stats.sysex++;
+    }
+}
+
+void trace_process() {
+    if (swo_ready()) {
+        drain_swo();
+        return;
+    }
+#if USB_CDC_CONSOLE
+    if (drain_cdc()) {
+        return;
+    }
+#endif
+    drain_sysex();
+}
+
+#endif
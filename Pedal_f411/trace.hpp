@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stdint.h>
+#include "rec_ring.hpp"
+#include "usb_profile.h" // USB_CDC_CONSOLE
+#include "isr_profile.h" // ISR_PROFILE
+
+// Трассировка с отложенным форматированием для прерываний и горячих путей.
+// TRACE("exti: pedal %u", n) встраивается в точку вызова: метка DWT->CYCCNT, id строки
+// и сырые аргументы — в кольцо trace_ring (rec_ring.hpp, одно на ядро), без вызова функций,
+// форматирования и запрета прерываний. Строки формата — в секции .trace_strings, которая,
+// как и .log_strings журнала, есть только в ELF; id — адрес строки. Текст собирает
+// tools/diag_log.py.
+//
+// Метка CYCCNT считает такты HCLK: регулятор частоты (clock_gov.cpp) ставит точку
+// "clk: hclk %u Hz", по ней декодер пересчитывает такты в секунды. trace_init()
+// включает DBG_SLEEP, чтобы счёт шёл и в WFI; в STOP (USB suspend) он всё же стоит.
+//
+// Слив — trace_process() из главного цикла, по первому доступному каналу:
+//   SWO — отладчик включил ITM и стимул-порт TRACE_ITM_PORT: записи словами в порт;
+//   CDC — при USB_CDC_CONSOLE и открытом порте, в один поток с журналом;
+//   SysEx — на кабеле диагностики: F0 7D 03 <слова записи по 5 байт, 7 бит, младшие первыми> F7.
+//
+// Цена точки: trace_init() калибрует её при старте (trace_stats.cost_cycles по числу
+// аргументов, лучший из TRACE_CALIBRATE_RUNS замеров, вместе с чтением CYCCNT).
+// В сборке с ISR_PROFILE каждая точка ещё и замеряется в работе (trace_cycles) —
+// видно и повторы STREX при вытеснении.
+// cmake -DISR_TRACE=ON
+
+#ifndef ISR_TRACE
+#define ISR_TRACE       0
+#endif
+
+static constexpr uint32_t TRACE_RING_WORDS = 512u;  // 2 КБ, 85..170 записей
+static constexpr uint32_t TRACE_ITM_PORT = 1u;      // порт 0 обычно занят printf
+
+extern rec_ring<TRACE_RING_WORDS, REC_LOST_TRACE> trace_ring;
+
+struct trace_stats_t {
+    uint32_t cost_cycles[REC_ARGS_MAX + 1u];    // калибровка: тактов на TRACE с 0..4 аргументами
+    uint32_t swo;                               // записей ушло по каналам
+    uint32_t cdc;
+    uint32_t sysex;
+};
+
+extern trace_stats_t trace_stats;
+
+// Точки в работе (ISR_PROFILE): count/last/max/total в тактах, как isr_cycles[]
+struct trace_cycles_t {
+    uint32_t count;
+    uint32_t last;
+    uint32_t max;
+    uint64_t total;
+};
+
+extern volatile trace_cycles_t trace_cycles;
+
+#if ISR_TRACE
+// Как LOG_ID (diag_log.hpp): не из inline-функций и шаблонов
+#define TRACE_ID(fmt) ({ \
+    static const char trace_fmt_[] __attribute__((section(".trace_strings"), used)) = fmt; \
+    reinterpret_cast<uint32_t>(trace_fmt_); })
+
+#define TRACE(fmt, ...) trace_emit(TRACE_ID(fmt), ##__VA_ARGS__)
+
+template <typename... A>
+__attribute__((always_inline)) inline void trace_emit(uint32_t id, A... a) {
+    static_assert(sizeof...(A) <= REC_ARGS_MAX, "too many TRACE arguments");
+    const uint32_t t0 = DWT->CYCCNT;
+    const uint32_t args[] = { static_cast<uint32_t>(a)..., 0u };
+    trace_ring.put(id, t0, args, sizeof...(A));
+#if ISR_PROFILE
+    const uint32_t dt = DWT->CYCCNT - t0;
+    trace_cycles.count = trace_cycles.count + 1u;
+    trace_cycles.last = dt;
+    trace_cycles.total = trace_cycles.total + dt;
+    if (dt > trace_cycles.max) {
+        trace_cycles.max = dt;
+    }
+#endif
+}
+
+// После pwr_init() (DWT включён): калибровка цены точки
+void trace_init();
+// Из главного цикла: записи -> SWO, CDC или SysEx
+void trace_process();
+#else
+#define TRACE(fmt, ...) do {} while (0)
+inline void trace_init() {}
+inline void trace_process() {}
+#endif
@@ -12,6 +12,8 @@
 extern "C" {
 #endif
 
+#include "usb_profile.h"
+
 #ifndef BOARD_TUD_RHPORT
 #define BOARD_TUD_RHPORT            0  // Для STM32F411 используем порт 0 (FS)
 #endif
@@ -54,18 +56,34 @@ extern "C" {
 #endif
 
 //------------- CLASS -------------//
-#define CFG_TUD_CDC               0
+#define CFG_TUD_CDC               USB_CDC_CONSOLE
 #define CFG_TUD_MSC               0
-#define CFG_TUD_HID               1
+#define CFG_TUD_HID               USB_HID
 #define CFG_TUD_MIDI              1
 #define CFG_TUD_VENDOR            0
 
-// MIDI FIFO size of TX and RX
-#define CFG_TUD_MIDI_RX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : 64)
-#define CFG_TUD_MIDI_TX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : 64)
+// MIDI FIFO size of TX and RX (см. usb_profile.h)
+#define CFG_TUD_MIDI_RX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : USB_MIDI_RX_BUFSIZE)
+#define CFG_TUD_MIDI_TX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : USB_MIDI_TX_BUFSIZE)
+#define CFG_TUD_MIDI_EP_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : USB_MIDI_EP_SIZE)
+#define CFG_TUD_MIDI_TX_SOF_SYNC  USB_TX_SOF_SYNC
+// MIDI IN без промежуточного буфера: DWC2 (slave mode) читает прямо из tx_ff
+#define CFG_TUD_MIDI_TX_XFER_FIFO 1
+// alt 1 интерфейса MIDI Streaming — UMP (USB-MIDI 2.0)
+#define CFG_TUD_MIDI_UMP          USB_MIDI2
+
+// У OTG_FS на F411 нет DMA (GHWCFG2.ARCH = slave), пакеты в FIFO пишет CPU.
+// Однопакетный IN кладётся в TX FIFO сразу при постановке, без прерывания TXFE
+#define CFG_TUD_DWC2_DMA_ENABLE        0
+#define CFG_TUD_DWC2_SLAVE_TX_PREFILL  1
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE    16
+#define CFG_TUD_HID_EP_BUFSIZE    USB_HID_EP_SIZE
+
+// CDC-консоль журнала: ввод не используется, вывод — двоичные записи diag_log
+#define CFG_TUD_CDC_RX_BUFSIZE    USB_CDC_EP_SIZE
+#define CFG_TUD_CDC_TX_BUFSIZE    USB_CDC_TX_BUFSIZE
+#define CFG_TUD_CDC_EP_BUFSIZE    USB_CDC_EP_SIZE
 
 
 
@@ -3,6 +3,7 @@
 #include "tusb_config.h"
 #include "usb_descriptors.h"
 #include "board_api.h"
+#include "boot_profile.h"
 
  /* A combination of interfaces must have a unique product id, since PC will save device driver after the first plug.
   * Same VID/PID with different interface e.g MSC (first), then CDC (later) will possibly cause system error on PC.
@@ -14,22 +15,50 @@
 #define USB_PID           (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | \
                            _PID_MAP(MIDI, 3) | _PID_MAP(VENDOR, 4) )
 
+static bool _low_latency = USB_PROFILE_LOW_LATENCY;
+
+void usb_profile_select(bool low_latency) {
+  _low_latency = low_latency;
+}
+
+bool usb_profile_low_latency(void) {
+  return _low_latency;
+}
+
+// Глубина tx_ff — по профилю, выбранному к моменту SET_CONFIGURATION
+uint16_t tud_midi_tx_bufsize_cb(uint8_t itf) {
+  (void) itf;
+#if TUD_OPT_HIGH_SPEED
+  return CFG_TUD_MIDI_TX_BUFSIZE;
+#else
+  return _low_latency ? USB_LL_MIDI_TX_BUFSIZE : USB_STD_MIDI_TX_BUFSIZE;
+#endif
+}
+
   //--------------------------------------------------------------------+
   // Device Descriptors
   //--------------------------------------------------------------------+
-tusb_desc_device_t const desc_device =
+// idProduct дополняется битом профиля в tud_descriptor_device_cb()
+static tusb_desc_device_t desc_device =
 {
     .bLength = sizeof(tusb_desc_device_t),
     .bDescriptorType = TUSB_DESC_DEVICE,
     .bcdUSB = 0x0200,
+#if USB_CDC_CONSOLE
+    // CDC из двух интерфейсов объединён IAD: Windows требует класс Misc/IAD у устройства
+    .bDeviceClass = TUSB_CLASS_MISC,
+    .bDeviceSubClass = MISC_SUBCLASS_COMMON,
+    .bDeviceProtocol = MISC_PROTOCOL_IAD,
+#else
     .bDeviceClass = 0x00,
     .bDeviceSubClass = 0x00,
     .bDeviceProtocol = 0x00,
+#endif
     .bMaxPacketSize0 = CFG_TUD_ENDPOINT0_SIZE,
 
     .idVendor = 0xCafe,
     .idProduct = USB_PID,
-    .bcdDevice = 0x0100,
+    .bcdDevice = 0x0200, // 2.00: три кабеля MIDI — хост перечитывает дескрипторы
 
     .iManufacturer = 0x01,
     .iProduct = 0x02,
@@ -41,6 +70,9 @@ tusb_desc_device_t const desc_device =
 // Invoked when received GET DEVICE DESCRIPTOR
 // Application return pointer to descriptor
 uint8_t const* tud_descriptor_device_cb(void) {
+  desc_device.idProduct = (uint16_t)(USB_PID | (_low_latency ? USB_PID_LOW_LATENCY_BIT : 0) |
+                                     (USB_MIDI2 ? USB_PID_MIDI2_BIT : 0) |
+                                     (MIDI_DIN ? USB_PID_DIN_BIT : 0));
   return (uint8_t const*)&desc_device;
 }
 
@@ -49,10 +81,31 @@ uint8_t const* tud_descriptor_device_cb(void) {
 // Configuration Descriptor
 //--------------------------------------------------------------------+
 
+// String Descriptor Index
+enum {
+  STRID_LANGID = 0,
+  STRID_MANUFACTURER,
+  STRID_PRODUCT,
+  STRID_SERIAL,
+  STRID_MIDI_INTERFACE,
+  STRID_HID_INTERFACE,
+  STRID_CABLE_PEDALS,
+  STRID_CABLE_SUSTAIN,
+  STRID_CABLE_DIAG,
+  STRID_CABLE_DIN,
+  STRID_CDC_INTERFACE,
+};
+
 enum {
-  ITF_NUM_HID = 0,
+#if USB_HID
+  ITF_NUM_HID,
+#endif
   ITF_NUM_MIDI,
   ITF_NUM_MIDI_STREAMING,
+#if USB_CDC_CONSOLE
+  ITF_NUM_CDC,
+  ITF_NUM_CDC_DATA,
+#endif
   ITF_NUM_TOTAL
 };
 
@@ -60,15 +113,37 @@ enum {
 // HID Report Descriptor
 //--------------------------------------------------------------------+
 
+#if USB_HID
+// Несколько Report ID в одном интерфейсе: boot-протокол их не поддерживает,
+// поэтому интерфейс объявлен как HID_ITF_PROTOCOL_NONE
 uint8_t const desc_hid_report[] =
 {
-  TUD_HID_REPORT_DESC_KEYBOARD()
+  TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD)),
+  TUD_HID_REPORT_DESC_CONSUMER(HID_REPORT_ID(REPORT_ID_CONSUMER_CONTROL)),
+  TUD_HID_REPORT_DESC_SYSTEM_CONTROL(HID_REPORT_ID(REPORT_ID_SYSTEM_CONTROL))
 };
+#endif
+
+#if USB_MIDI2
+#define MIDI2_ALT_DESC_LEN  (9 + 7 + 2 * (7 + 4 + USB_MIDI_CABLES))
+#else
+#define MIDI2_ALT_DESC_LEN  0
+#endif
+
+#define MIDI_DESC_LEN  (TUD_MIDI_DESC_HEAD_LEN + USB_MIDI_CABLES * TUD_MIDI_DESC_JACK_LEN + 2 * TUD_MIDI_DESC_EP_LEN(USB_MIDI_CABLES))
 
-#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_MIDI_DESC_LEN)
+#define HID_DESC_LEN  (USB_HID ? TUD_HID_DESC_LEN : 0)
+#define CDC_DESC_LEN  (USB_CDC_CONSOLE ? TUD_CDC_DESC_LEN : 0)
+
+#define CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + HID_DESC_LEN + MIDI_DESC_LEN + MIDI2_ALT_DESC_LEN + CDC_DESC_LEN)
 
 #define EPNUM_HID   0x82
 
+// CDC занимает endpoint'ы HID (без HID в этой сборке) и последний свободный EP3 IN
+#define EPNUM_CDC_NOTIF   0x83
+#define EPNUM_CDC_OUT     0x02
+#define EPNUM_CDC_IN      0x82
+
 #if CFG_TUSB_MCU == OPT_MCU_LPC175X_6X || CFG_TUSB_MCU == OPT_MCU_LPC177X_8X || CFG_TUSB_MCU == OPT_MCU_LPC40XX
 // LPC 17xx and 40xx endpoint type (bulk/interrupt/iso) are fixed by its number
 // 0 control, 1 In, 2 Bulk, 3 Iso, 4 In etc ...
@@ -83,32 +158,136 @@ uint8_t const desc_hid_report[] =
 #define EPNUM_MIDI_IN   0x01
 #endif
 
+// MIDI endpoint: bulk или interrupt (Audio v1.0 endpoint — 9 байт, bInterval в кадрах)
+// и список embedded jack'ов — по одному на кабель
+#define MIDI_DESC_EP(_ep, _epsize, _interrupt, _interval) \
+  9, TUSB_DESC_ENDPOINT, _ep, ((_interrupt) ? TUSB_XFER_INTERRUPT : TUSB_XFER_BULK), U16_TO_U8S_LE(_epsize), _interval, 0, 0, \
+  4 + USB_MIDI_CABLES, TUSB_DESC_CS_ENDPOINT, MIDI_CS_ENDPOINT_GENERAL, USB_MIDI_CABLES
+
+// Четвёртый кабель — мост DIN, только в сборке с MIDI_DIN
+#if MIDI_DIN
+#define DIN_JACK_DESC     , TUD_MIDI_DESC_JACK_DESC(4, STRID_CABLE_DIN)
+#define DIN_JACKID_IN     , TUD_MIDI_JACKID_IN_EMB(4)
+#define DIN_JACKID_OUT    , TUD_MIDI_JACKID_OUT_EMB(4)
+#define DIN_GTB_ID        , 4
+#else
+#define DIN_JACK_DESC
+#define DIN_JACKID_IN
+#define DIN_JACKID_OUT
+#define DIN_GTB_ID
+#endif
+
+// То же, что TUD_MIDI_DESCRIPTOR, но с выбором типа endpoint'ов и именованными кабелями
+#define MIDI_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize, _interrupt, _interval) \
+  TUD_MIDI_DESC_HEAD(_itfnum, _stridx, USB_MIDI_CABLES),\
+  TUD_MIDI_DESC_JACK_DESC(1, STRID_CABLE_PEDALS),\
+  TUD_MIDI_DESC_JACK_DESC(2, STRID_CABLE_SUSTAIN),\
+  TUD_MIDI_DESC_JACK_DESC(3, STRID_CABLE_DIAG) DIN_JACK_DESC,\
+  MIDI_DESC_EP(_epout, _epsize, _interrupt, _interval),\
+  TUD_MIDI_JACKID_IN_EMB(1), TUD_MIDI_JACKID_IN_EMB(2), TUD_MIDI_JACKID_IN_EMB(3) DIN_JACKID_IN,\
+  MIDI_DESC_EP(_epin, _epsize, _interrupt, _interval),\
+  TUD_MIDI_JACKID_OUT_EMB(1), TUD_MIDI_JACKID_OUT_EMB(2), TUD_MIDI_JACKID_OUT_EMB(3) DIN_JACKID_OUT
+
+TU_VERIFY_STATIC(USB_MIDI_CABLES == 3 + MIDI_DIN, "MIDI_DESCRIPTOR lists jacks for 3 cables + DIN");
+
+// USB-MIDI 2.0, alt 1 интерфейса MIDI Streaming: заголовок bcdMSC 2.0 без jack'ов,
+// те же endpoint'ы (стандартный 7-байтный дескриптор) и ссылки на Group Terminal Block 1..3
+#define MIDI2_EP_DESC(_ep, _epsize, _interrupt, _interval) \
+  7, TUSB_DESC_ENDPOINT, _ep, ((_interrupt) ? TUSB_XFER_INTERRUPT : TUSB_XFER_BULK), U16_TO_U8S_LE(_epsize), _interval, \
+  4 + USB_MIDI_CABLES, TUSB_DESC_CS_ENDPOINT, MIDI_CS_ENDPOINT_GENERAL_2_0, USB_MIDI_CABLES, 1, 2, 3 DIN_GTB_ID
+
+#define MIDI2_ALT_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize, _interrupt, _interval) \
+  9, TUSB_DESC_INTERFACE, _itfnum, 1, 2, TUSB_CLASS_AUDIO, AUDIO_SUBCLASS_MIDI_STREAMING, AUDIO_FUNC_PROTOCOL_CODE_UNDEF, _stridx,\
+  7, TUSB_DESC_CS_INTERFACE, MIDI_CS_INTERFACE_HEADER, U16_TO_U8S_LE(MIDI_VERSION_2_0), U16_TO_U8S_LE(7),\
+  MIDI2_EP_DESC(_epout, _epsize, _interrupt, _interval),\
+  MIDI2_EP_DESC(_epin, _epsize, _interrupt, _interval)
+
+#if USB_MIDI2
+#define MIDI2_ALT(...)  , MIDI2_ALT_DESCRIPTOR(__VA_ARGS__)
+#else
+#define MIDI2_ALT(...)
+#endif
+
+#if USB_HID
+/* Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval */
+#define HID_DESC(_hid_poll) \
+  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 5, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, _hid_poll),
+#else
+#define HID_DESC(_hid_poll)
+#endif
+
+#if USB_CDC_CONSOLE
+/* Interface number, string index, EP notification address and size, EP data address (out, in) and size */
+#define CDC_DESC \
+  , TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, STRID_CDC_INTERFACE, EPNUM_CDC_NOTIF, USB_CDC_NOTIF_EP_SIZE, EPNUM_CDC_OUT, EPNUM_CDC_IN, USB_CDC_EP_SIZE)
+#else
+#define CDC_DESC
+#endif
+
+#define DESC_CONFIGURATION(_midi_epsize, _hid_poll, _midi_interrupt, _midi_interval) \
+  /* Config number, interface count, string index, total length, attribute, power in mA */\
+  TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),\
+  HID_DESC(_hid_poll)\
+  /* Interface number, string index, EP Out & EP In address, EP size, type & polling interval */\
+  MIDI_DESCRIPTOR(ITF_NUM_MIDI, 4, EPNUM_MIDI_OUT, (0x80 | EPNUM_MIDI_IN), _midi_epsize, _midi_interrupt, _midi_interval)\
+  MIDI2_ALT(ITF_NUM_MIDI_STREAMING, 4, EPNUM_MIDI_OUT, (0x80 | EPNUM_MIDI_IN), _midi_epsize, _midi_interrupt, _midi_interval)\
+  CDC_DESC
+
 uint8_t const desc_fs_configuration[] =
 {
-  // Config number, interface count, string index, total length, attribute, power in mA
-  TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x00, 100),
-
-  // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 5, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 10),
+  DESC_CONFIGURATION(USB_MIDI_EP_SIZE, USB_STD_HID_POLL_MS, USB_STD_MIDI_EP_INTERRUPT, USB_STD_MIDI_EP_INTERVAL)
+};
 
-  // Interface number, string index, EP Out & EP In address, EP size
-  TUD_MIDI_DESCRIPTOR(ITF_NUM_MIDI, 4, EPNUM_MIDI_OUT, (0x80 | EPNUM_MIDI_IN), 64)
+uint8_t const desc_fs_configuration_ll[] =
+{
+  DESC_CONFIGURATION(USB_MIDI_EP_SIZE, USB_LL_HID_POLL_MS, USB_LL_MIDI_EP_INTERRUPT, USB_LL_MIDI_EP_INTERVAL)
 };
 
+TU_VERIFY_STATIC(sizeof(desc_fs_configuration) == CONFIG_TOTAL_LEN, "bad config descriptor length");
+TU_VERIFY_STATIC(sizeof(desc_fs_configuration_ll) == CONFIG_TOTAL_LEN, "bad config descriptor length");
+TU_VERIFY_STATIC(USB_MIDI_EP_SIZE <= CFG_TUD_MIDI_EP_BUFSIZE, "MIDI EP size exceeds EP buffer");
+
 #if TUD_OPT_HIGH_SPEED
 uint8_t const desc_hs_configuration[] =
 {
-  // Config number, interface count, string index, total length, attribute, power in mA
-  TUD_CONFIG_DESCRIPTOR(1, ITF_NUM_TOTAL, 0, CONFIG_TOTAL_LEN, 0x00, 100),
+  DESC_CONFIGURATION(512, USB_STD_HID_POLL_MS, USB_STD_MIDI_EP_INTERRUPT, USB_STD_MIDI_EP_INTERVAL)
+};
+#endif
+
+#if USB_MIDI2
+// bMIDIProtocol: 0x11 — MIDI 2.0, 0x12 — MIDI 2.0 с JR Timestamps. JR Timestamp
+// и JR Clock — служебные UMP без группы, поэтому протокол общий для всех блоков
+#if MIDI_TIMESTAMPS
+#define MIDI2_GTB_PROTOCOL  0x12
+#else
+#define MIDI2_GTB_PROTOCOL  0x11
+#endif
 
-  // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-  TUD_HID_DESCRIPTOR(ITF_NUM_HID, 5, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), EPNUM_HID, CFG_TUD_HID_EP_BUFSIZE, 10),
+// Двунаправленный блок на кабель: группа = номер кабеля
+#define MIDI2_GTB(_id, _group, _stridx) \
+  13, MIDI_CS_GR_TRM_BLOCK, MIDI_GR_TRM_BLOCK, _id, 0x00 /* bidirectional */, _group /* first group */, 1 /* groups */,\
+  _stridx /* iBlockItem */, MIDI2_GTB_PROTOCOL, U16_TO_U8S_LE(0), U16_TO_U8S_LE(0)
 
-  // Interface number, string index, EP Out & EP In address, EP size
-  TUD_MIDI_DESCRIPTOR(ITF_NUM_MIDI, 4, EPNUM_MIDI_OUT, (0x80 | EPNUM_MIDI_IN), 512)
+uint8_t const desc_midi2_gtb[] =
+{
+  5, MIDI_CS_GR_TRM_BLOCK, MIDI_GR_TRM_BLOCK_HEADER, U16_TO_U8S_LE(5 + 13 * USB_MIDI_CABLES),
+  MIDI2_GTB(1, 0, STRID_CABLE_PEDALS),
+  MIDI2_GTB(2, 1, STRID_CABLE_SUSTAIN),
+  MIDI2_GTB(3, 2, STRID_CABLE_DIAG)
+#if MIDI_DIN
+  , MIDI2_GTB(4, 3, STRID_CABLE_DIN)
+#endif
 };
+
+uint8_t const* tud_midi_descriptor_group_terminal_block_cb(uint8_t itf, uint16_t* len)
+{
+  (void) itf;
+  *len = sizeof(desc_midi2_gtb);
+  return desc_midi2_gtb;
+}
 #endif
 
+#if USB_HID
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
@@ -117,6 +296,7 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t instance)
   (void) instance;
   return desc_hid_report;
 }
+#endif
 
 // Invoked when received GET CONFIGURATION DESCRIPTOR
 // Application return pointer to descriptor
@@ -128,7 +308,7 @@ uint8_t const* tud_descriptor_configuration_cb(uint8_t index) {
   // Although we are highspeed, host may be fullspeed.
   return (tud_speed_get() == TUSB_SPEED_HIGH) ? desc_hs_configuration : desc_fs_configuration;
 #else
-  return desc_fs_configuration;
+  return _low_latency ? desc_fs_configuration_ll : desc_fs_configuration;
 #endif
 }
 
@@ -136,15 +316,7 @@ uint8_t const* tud_descriptor_configuration_cb(uint8_t index) {
 // String Descriptors
 //--------------------------------------------------------------------+
 
-// String Descriptor Index
-enum {
-  STRID_LANGID = 0,
-  STRID_MANUFACTURER,
-  STRID_PRODUCT,
-  STRID_SERIAL,
-  STRID_MIDI_INTERFACE,
-  STRID_HID_INTERFACE,
-};
+// STRID_* — выше: на них ссылаются дескрипторы jack'ов и Group Terminal Block
 
 // array of pointer to string descriptors
 char const* string_desc_arr[] =
@@ -153,7 +325,12 @@ char const* string_desc_arr[] =
 "SCHE MIDI Pedal",            // 2: Product
 NULL,                          // 3: Serials will use unique ID if possible
 "MIDI Interface",              // 4: MIDI Interface
-"HID Keyboard",                // 5: HID Interface
+"HID Keyboard/Media",          // 5: HID Interface
+"Pedals",                      // 6: MIDI cable 1, ноты педалей
+"Sustain",                     // 7: MIDI cable 2, CC#64
+"Diagnostics",                 // 8: MIDI cable 3, SysEx отчёты
+"DIN",                         // 9: MIDI cable 4, мост на разъём DIN (MIDI_DIN)
+"Diagnostic Console",          // 10: CDC, журнал diag_log (USB_CDC_CONSOLE)
 };
 
 static uint16_t _desc_str[32 + 1];
@@ -208,7 +385,11 @@ uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid) {
 // Invoked when device is mounted
 void tud_mount_cb(void)
 {
-  // Device mounted callback
+  boot_mark(BOOT_STAGE_MOUNTED);
+#if USB_TX_SOF_SYNC
+  // HID-диспетчер работает от tud_sof_cb() (см. hid_reports.cpp)
+  tud_sof_cb_enable(true);
+#endif
 }
 
 // Invoked when device is unmounted
@@ -217,20 +398,11 @@ void tud_umount_cb(void)
   // Device unmounted callback
 }
 
-// Invoked when usb bus is suspended
-// remote_wakeup_en : if host allow us to perform remote wakeup
-// Within 7ms, device must draw an average of current less than 2.5 mA from bus
-void tud_suspend_cb(bool remote_wakeup_en)
-{
-  (void) remote_wakeup_en;
-}
-
-// Invoked when usb bus is resumed
-void tud_resume_cb(void)
-{
-}
+// tud_suspend_cb / tud_resume_cb — в power.cpp: suspend переводит MCU в STOP,
+// нажатие педали во время suspend будит хост (remote wakeup)
 
 
+#if USB_HID
 //--------------------------------------------------------------------+
 // HID Callbacks
 //--------------------------------------------------------------------+
@@ -259,3 +431,4 @@ void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_
   (void) buffer;
   (void) bufsize;
 }
+#endif
@@ -2,4 +2,12 @@
 
 // #include "bsp/board_api.h"
 // #include "tusb.h"
-// #include "tusb_config.h"
\ No newline at end of file
+// #include "tusb_config.h"
+
+// Report ID для составного HID-интерфейса (клавиатура + мультимедиа + питание)
+enum {
+  REPORT_ID_KEYBOARD = 1,
+  REPORT_ID_CONSUMER_CONTROL,
+  REPORT_ID_SYSTEM_CONTROL,
+  REPORT_ID_COUNT
+};
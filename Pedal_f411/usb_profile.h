@@ -0,0 +1,106 @@
+/*
+ * usb_profile.h
+ * Единая таблица параметров USB-профилей: интервалы опроса, типы и размеры
+ * endpoint'ов, размеры FIFO. Из неё строятся дескрипторы (usb_descriptors.c)
+ * и буферы TinyUSB (tusb_config.h), поэтому PID и таблицы endpoint'ов
+ * не расходятся между собой.
+ */
+
+#ifndef USB_PROFILE_H_
+#define USB_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+
+// Профиль по умолчанию: 0 — стандартный, 1 — низкая задержка.
+// Задаётся при сборке: cmake -DUSB_PROFILE_LOW_LATENCY=ON
+#ifndef USB_PROFILE_LOW_LATENCY
+#define USB_PROFILE_LOW_LATENCY     0
+#endif
+
+// Отправка по SOF: IN-транзакции MIDI и HID взводятся раз в кадр, а не на каждое
+// событие. События одного кадра уходят одним пакетом, фаза относительно опроса
+// хоста фиксирована. cmake -DUSB_TX_SOF_SYNC=ON
+#ifndef USB_TX_SOF_SYNC
+#define USB_TX_SOF_SYNC             0
+#endif
+
+// USB-MIDI 2.0: у интерфейса MIDI Streaming появляется alt 1 с UMP на тех же
+// endpoint'ах. Хост без поддержки MIDI 2.0 остаётся на alt 0 (MIDI 1.0).
+// cmake -DUSB_MIDI2=ON
+#ifndef USB_MIDI2
+#define USB_MIDI2                   0
+#endif
+
+// Метки времени событий (midi_out.hpp). Здесь, а не в midi_out.hpp: от неё зависит
+// bMIDIProtocol блоков в usb_descriptors.c. cmake -DMIDI_TIMESTAMPS=ON
+#ifndef MIDI_TIMESTAMPS
+#define MIDI_TIMESTAMPS             0
+#endif
+
+// Разъём MIDI DIN на USART1 (midi_din.hpp): OUT на PA9, IN на PA10.
+// cmake -DMIDI_DIN=ON
+#ifndef MIDI_DIN
+#define MIDI_DIN                    0
+#endif
+
+// Диагностическая консоль CDC-ACM (diag_log.hpp). У OTG_FS на F411 кроме EP0 три
+// IN endpoint'а: MIDI, HID и два у CDC (уведомления + данные) вместе не помещаются,
+// поэтому в этой сборке CDC встаёт на место HID. cmake -DUSB_CDC_CONSOLE=ON
+#ifndef USB_CDC_CONSOLE
+#define USB_CDC_CONSOLE             0
+#endif
+#define USB_HID                     (!USB_CDC_CONSOLE)
+
+// Виртуальные кабели MIDI: embedded jack'и IN/OUT с именами, в UMP — группы 1..4.
+// 0 — ноты педалей, 1 — sustain, 2 — диагностика, 3 — мост DIN (только с MIDI_DIN)
+// (см. midi_cable в midi_out.hpp)
+#define USB_MIDI_CABLES             (3 + MIDI_DIN)
+
+// Стандартный профиль: HID опрашивается раз в 10 мс, MIDI — bulk
+#define USB_STD_HID_POLL_MS         10
+#define USB_STD_MIDI_EP_INTERRUPT   0
+#define USB_STD_MIDI_EP_INTERVAL    0
+
+// Профиль низкой задержки: HID и MIDI — interrupt endpoint с опросом каждый кадр (1 мс)
+#define USB_LL_HID_POLL_MS          1
+#define USB_LL_MIDI_EP_INTERRUPT    1
+#define USB_LL_MIDI_EP_INTERVAL     1
+
+// Общие для обоих профилей (буферы выделяются при сборке)
+#define USB_MIDI_EP_SIZE            64   // FS: максимум для bulk и interrupt
+#define USB_HID_EP_SIZE             16
+#define USB_CDC_EP_SIZE             64
+#define USB_CDC_NOTIF_EP_SIZE       8
+#define USB_CDC_TX_BUFSIZE          512  // ~80 записей журнала, пока хост не забрал
+
+// TX FIFO: в режиме низкой задержки держим два кадра событий, чтобы следующий
+// пакет уже лежал в FIFO, пока предыдущий ждёт IN-токен хоста. Буфер выделяется
+// под больший профиль, глубину tx_ff задаёт выбранный при открытии интерфейса
+// (tud_midi_tx_bufsize_cb) — профиль, выбранный педалью B, получает свою
+#define USB_STD_MIDI_TX_BUFSIZE     USB_MIDI_EP_SIZE
+#define USB_LL_MIDI_TX_BUFSIZE      (2 * USB_MIDI_EP_SIZE)
+#define USB_MIDI_TX_BUFSIZE         USB_LL_MIDI_TX_BUFSIZE
+// RX FIFO: OUT взводится, только когда в FIFO есть место под целый пакет.
+// Два пакета — следующий принимается, пока midi_in_process() разбирает текущий
+#define USB_MIDI_RX_BUFSIZE         (2 * USB_MIDI_EP_SIZE)
+
+// Бит PID профиля: хост кэширует дескрипторы по VID/PID, поэтому
+// профили с разными endpoint'ами обязаны иметь разные PID
+#define USB_PID_LOW_LATENCY_BIT     (1u << 5)
+#define USB_PID_MIDI2_BIT           (1u << 6)
+#define USB_PID_DIN_BIT             (1u << 7)
+
+// Выбор профиля во время работы. Действует при следующем подключении:
+// до tud_init() или между tud_disconnect() и tud_connect().
+void usb_profile_select(bool low_latency);
+bool usb_profile_low_latency(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* USB_PROFILE_H_ */
@@ -0,0 +1,47 @@
+// tinyusb/src/common/tusb_fifo.c as it was before the power-of-two index and word
+// copy change (tests/base/tusb_fifo.c, unmodified), linked next to the current one
+// under the tu_fifo_base_ prefix so bench_tu_fifo can time both in one binary.
+//
+// Building tests/base/tusb_fifo.c: force-included with TU_FIFO_BASE_BUILD, renames
+// every exported symbol. Anywhere else: prototypes of the renamed functions used.
+
+#ifndef TU_FIFO_BASE_H_
+#define TU_FIFO_BASE_H_
+
+#ifdef TU_FIFO_BASE_BUILD
+
+#define tu_fifo_config                        tu_fifo_base_config
+#define tu_fifo_count                         tu_fifo_base_count
+#define tu_fifo_empty                         tu_fifo_base_empty
+#define tu_fifo_full                          tu_fifo_base_full
+#define tu_fifo_remaining                     tu_fifo_base_remaining
+#define tu_fifo_overflowed                    tu_fifo_base_overflowed
+#define tu_fifo_correct_read_pointer          tu_fifo_base_correct_read_pointer
+#define tu_fifo_read                          tu_fifo_base_read
+#define tu_fifo_read_n                        tu_fifo_base_read_n
+#define tu_fifo_read_n_const_addr_full_words  tu_fifo_base_read_n_const_addr_full_words
+#define tu_fifo_peek                          tu_fifo_base_peek
+#define tu_fifo_peek_n                        tu_fifo_base_peek_n
+#define tu_fifo_write                         tu_fifo_base_write
+#define tu_fifo_write_n                       tu_fifo_base_write_n
+#define tu_fifo_write_n_const_addr_full_words tu_fifo_base_write_n_const_addr_full_words
+#define tu_fifo_clear                         tu_fifo_base_clear
+#define tu_fifo_set_overwritable              tu_fifo_base_set_overwritable
+#define tu_fifo_advance_write_pointer         tu_fifo_base_advance_write_pointer
+#define tu_fifo_advance_read_pointer          tu_fifo_base_advance_read_pointer
+#define tu_fifo_get_read_info                 tu_fifo_base_get_read_info
+#define tu_fifo_get_write_info                tu_fifo_base_get_write_info
+
+#else
+
+#include "common/tusb_fifo.h"
+
+bool     tu_fifo_base_config   (tu_fifo_t *f, void* buffer, uint16_t depth, uint16_t item_size, bool overwritable);
+uint16_t tu_fifo_base_count    (tu_fifo_t* f);
+uint16_t tu_fifo_base_remaining(tu_fifo_t* f);
+uint16_t tu_fifo_base_read_n   (tu_fifo_t* f, void * buffer, uint16_t n);
+uint16_t tu_fifo_base_write_n  (tu_fifo_t* f, const void * data, uint16_t n);
+
+#endif
+
+#endif /* TU_FIFO_BASE_H_ */
@@ -0,0 +1,150 @@
+// Host microbenchmark of the MIDI IN (device -> host) transmit path in
+// tinyusb/src/class/midi/midi_device.c, write_flush():
+//
+//   epbuf      CFG_TUD_MIDI_TX_XFER_FIFO 0: tu_fifo_read_n() into the 64-byte endpoint
+//              buffer, then dfifo_write_packet() pushes it into the DWC2 TX FIFO
+//   xfer_fifo  CFG_TUD_MIDI_TX_XFER_FIFO 1: the DCD pulls straight from tx_ff into the
+//              TX FIFO with tu_fifo_read_n_const_addr_full_words()
+//
+// Events are 4-byte USB-MIDI packets written with tu_fifo_write_n(), as
+// tud_midi_n_packet_write() does, in bursts of 1..16 and flushed in endpoint-sized
+// transfers. The TX FIFO is a volatile word, as the OTG_FS FIFO register.
+// "copies" counts every pass of the event bytes through memory, measured in bytes
+// moved per byte of events.
+//
+// Host numbers only rank the variants; cycles on the Cortex-M4 come from the
+// Bench preset (ISR_PROFILE, isr_cycles[ISR_ID_USB]).
+//
+//   bench_midi_tx [events]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "osal/osal.h"
+#include "common/tusb_fifo.h"
+
+#define EP_SIZE       64
+#define TX_FF_SIZE    256
+#define BURST_MAX     16
+#define PASSES        7
+
+static double now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec * 1e9 + (double) ts.tv_nsec;
+}
+
+// OTG_FS TX FIFO register
+static volatile uint32_t tx_fifo;
+static uint64_t moved;
+
+// Same loop as dfifo_write_packet() in dwc2_common.c
+static void fifo_write_packet(uint8_t const* src, uint16_t len)
+{
+  uint16_t word_count = len >> 2;
+  while ( word_count-- )
+  {
+    tx_fifo = tu_unaligned_read32(src);
+    src += 4;
+  }
+  uint8_t const bytes_rem = len & 0x03;
+  if ( bytes_rem )
+  {
+    uint32_t tmp_word = src[0];
+    if ( bytes_rem > 1 ) tmp_word |= (src[1] << 8);
+    if ( bytes_rem > 2 ) tmp_word |= (src[2] << 16);
+    tx_fifo = tmp_word;
+  }
+  moved += len;
+}
+
+static void flush_epbuf(tu_fifo_t* ff)
+{
+  static uint8_t epin[EP_SIZE];
+  while ( tu_fifo_count(ff) )
+  {
+    uint16_t const count = tu_fifo_read_n(ff, epin, EP_SIZE);
+    moved += count;
+    fifo_write_packet(epin, count);
+  }
+}
+
+static void flush_xfer_fifo(tu_fifo_t* ff)
+{
+  while ( tu_fifo_count(ff) )
+  {
+    uint16_t const count = tu_min16(tu_fifo_count(ff), EP_SIZE);
+    tu_fifo_read_n_const_addr_full_words(ff, (void*) (uintptr_t) &tx_fifo, count);
+    moved += count;
+  }
+}
+
+typedef struct
+{
+  double   ns_per_event;
+  double   copies;
+} result_t;
+
+static result_t bench(void (*flush)(tu_fifo_t*), unsigned events)
+{
+  static uint32_t ff_buf[TX_FF_SIZE / 4];
+  tu_fifo_t ff;
+  tu_fifo_config(&ff, ff_buf, TX_FF_SIZE, 1, false);
+
+  uint32_t rng = 0x2545f491u;
+  uint8_t pkt[4] = { 0x09, 0x90, 0x3c, 0x7f };
+  moved = 0;
+
+  double const t0 = now_ns();
+  unsigned sent = 0;
+  while ( sent < events )
+  {
+    rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+    unsigned const burst = 1 + (rng % BURST_MAX);
+    for ( unsigned i = 0; i < burst; i++ )
+    {
+      tu_fifo_write_n(&ff, pkt, 4);     // tud_midi_n_packet_write()
+      moved += 4;
+      pkt[2]++;
+    }
+    sent += burst;
+    flush(&ff);
+  }
+  double const t1 = now_ns();
+
+  result_t r = { (t1 - t0) / sent, (double) moved / (4.0 * sent) };
+  return r;
+}
+
+int main(int argc, char** argv)
+{
+  unsigned const events = (argc > 1) ? (unsigned) strtoul(argv[1], NULL, 0) : 2000000;
+
+  static struct
+  {
+    char const* name;
+    void (*flush)(tu_fifo_t*);
+  } const runs[] =
+  {
+    { "epbuf     (TX_XFER_FIFO 0)", flush_epbuf },
+    { "xfer_fifo (TX_XFER_FIFO 1)", flush_xfer_fifo },
+  };
+
+  printf("midi tx: packet_write + write_flush, bursts 1..%u, %u events, best of %u\n", BURST_MAX, events, PASSES);
+  for ( unsigned i = 0; i < sizeof(runs) / sizeof(runs[0]); i++ )
+  {
+    // Warm-up pass, then the best of PASSES: host timer and cache noise only add
+    bench(runs[i].flush, events / 10 + 1);
+    result_t r = bench(runs[i].flush, events);
+    for ( unsigned p = 1; p < PASSES; p++ )
+    {
+      result_t const again = bench(runs[i].flush, events);
+      if ( again.ns_per_event < r.ns_per_event ) r = again;
+    }
+    printf("  %s: %.1f copies/event, %6.2f ns/event\n", runs[i].name, r.copies, r.ns_per_event);
+  }
+
+  return 0;
+}
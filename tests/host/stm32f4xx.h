@@ -0,0 +1,10 @@
+// Host stand-in for the CMSIS device header: only what the pure headers
+// under Pedal_f411/ use (pedal_queue.hpp)
+#pragma once
+
+#define EXTI_IMR_MR0    0x00000001u
+#define EXTI_IMR_MR1    0x00000002u
+#define EXTI_IMR_MR2    0x00000004u
+#define EXTI_IMR_MR3    0x00000008u
+
+#define __DMB()         __atomic_thread_fence(__ATOMIC_SEQ_CST)
@@ -0,0 +1,5 @@
+// Host build of TinyUSB common code for tests/ (no MCU, no RTOS)
+#pragma once
+
+#define CFG_TUSB_MCU    OPT_MCU_NONE
+#define CFG_TUSB_OS     OPT_OS_NONE
@@ -0,0 +1,314 @@
+// Джиттер MIDI Clock на источнике: модель TIM4 + USART1/DMA2 с тем же кодом решений,
+// что в прошивке (Pedal_f411/midi_clock.hpp, Pedal_f411/midi_din.hpp).
+//
+// Время — мкс. Тапы с человеческим разбросом проходят tap_estimate/tap_smooth, темп
+// дальше идёт через clock_next_arr, как в TIM4. На каждом тике считается:
+//   USB — момент записи 0xF8 в tx_ff (вход в TIM4_IRQHandler; если главный цикл как раз
+//         пишет tx_ff — конец его записи, midi_out_realtime_isr/tx_end);
+//   DIN — начало стартового бита 0xF8 на линии (DR + сдвиговый регистр USART, блоки DMA
+//         по din_block_max при случайных проходах главного цикла и потоке нот/CC).
+// Джиттер — отклонение от идеальной сетки тиков (период в Q8 без округления).
+// Для сравнения та же нагрузка гоняется по старой схеме: 0xF8 из главного цикла,
+// блоки DMA по DIN_BLOCK_MAX без учёта тика.
+// Отдельно — clock_run: после Stop clock выдыхается и перестаёт держать HCLK и STOP.
+//
+//   test_midi_clock [seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "midi_clock.hpp"
+#include "midi_din.hpp"
+
+static constexpr double JITTER_MAX_US = 100.0;      // требование к источнику
+static constexpr uint32_t TICKS = 24u * 4u * 64u;    // 64 такта по 4/4
+
+// Модель ядра: вход в прерывание приоритета 0 — 12 тактов плюс самое длинное окно
+// с запрещёнными прерываниями (сборка блока DIN, tx_end) — с запасом для 24 МГц
+static constexpr double ISR_ENTRY_US = 0.5;
+static constexpr double IRQ_MASKED_MAX_US = 8.0;
+// Запись главного цикла в tx_ff (tud_midi_n_packet_write + write_flush)
+static constexpr double TX_WRITE_MAX_US = 15.0;
+// Проход главного цикла: обычно короткий, изредка длинный (USB control, SysEx)
+static constexpr double LOOP_SHORT_MAX_US = 400.0;
+static constexpr double LOOP_LONG_MAX_US = 4000.0;
+// Ёмкость очередей нот и CC в байтах (оценка снизу)
+static constexpr uint32_t DIN_QUEUE_BYTES = 48u;
+
+static uint32_t rng_state;
+
+static uint32_t rng() {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+static double urand(double lo, double hi) {
+    return lo + (hi - lo) * (rng() / 4294967296.0);
+}
+
+static unsigned failures;
+
+#define CHECK(_cond, ...)                                                      \
+    do {                                                                       \
+        if (!(_cond)) {                                                        \
+            failures++;                                                        \
+            printf("FAIL %s:%d %s: ", __FILE__, __LINE__, #_cond);             \
+            printf(__VA_ARGS__);                                               \
+            printf("\n");                                                      \
+        }                                                                      \
+    } while (0)
+
+//--------------------------------------------------------------------+
+// Тапы -> период тика, как tap() в midi_clock.cpp
+//--------------------------------------------------------------------+
+struct tapper {
+    uint32_t taps[TAP_HISTORY] = {};
+    uint32_t count = 0u;
+    uint32_t interval = 0u;
+
+    // dt — интервал тапа в тиках TIM5 (100 мкс); 0 — темп ещё не задан
+    uint32_t tap(uint32_t dt) {
+        if (dt < TAP_INTERVAL_MIN || dt > TAP_INTERVAL_MAX) {
+            return interval ? clock_period_q8(interval) : 0u;
+        }
+        for (uint32_t i = TAP_HISTORY - 1u; i > 0u; --i) {
+            taps[i] = taps[i - 1u];
+        }
+        taps[0] = dt;
+        if (count < TAP_HISTORY) {
+            ++count;
+        }
+        if (count < 2u) {
+            return 0u;
+        }
+        interval = tap_smooth(interval, tap_estimate(taps, count));
+        return clock_period_q8(interval);
+    }
+};
+
+//--------------------------------------------------------------------+
+// USART1 TX: DR + сдвиговый регистр
+//--------------------------------------------------------------------+
+struct line {
+    double shift_end = 0.0;     // сдвиговый регистр свободен с этого момента
+    double dr_until = 0.0;      // DR занят до этого момента (байт ждёт сдвигового регистра)
+
+    bool txe(double t) const { return t >= dr_until; }
+    bool tc(double t) const { return t >= shift_end; }
+
+    // Запись в DR при TXE: возвращает начало стартового бита
+    double write(double t) {
+        const double start = t > shift_end ? t : shift_end;
+        dr_until = start;       // в сдвиговый регистр байт уходит в момент старта
+        shift_end = start + DIN_BYTE_US;
+        return start;
+    }
+};
+
+struct stats {
+    double usb_max = 0.0;
+    double din_max = 0.0;
+    double din_sum2 = 0.0;
+    uint32_t ticks = 0u;
+    uint32_t din_waited = 0u;   // 0xF8 застал линию занятой
+    uint32_t bytes = 0u;        // байт потока нот/CC ушло на DIN
+    uint32_t lost = 0u;         // байт нот/CC потеряно: очереди полны
+};
+
+// new_scheme — прошивка после переноса 0xF8 в прерывание; иначе старая схема
+static stats run(bool new_scheme, uint32_t seed) {
+    rng_state = seed;
+    stats st;
+    line ln;
+
+    // Темп: 120 BPM, через 16 тактов — 138 BPM, тапы с разбросом ±15 мс
+    tapper tp;
+    uint32_t period_q8 = 0u;
+    for (uint32_t i = 0u; i < 4u; ++i) {
+        period_q8 = tp.tap(5000u + static_cast<uint32_t>(urand(-150.0, 150.0)));
+    }
+
+    uint32_t frac = 0u;
+    double t_tick = 0.0;        // фактическое событие обновления TIM4
+    double t_ideal = 0.0;       // идеальная сетка
+    double next_pass = 0.0;     // следующий проход главного цикла
+    double dma_until = -1.0;    // DMA EN до этого момента (отдал последний байт в DR)
+    uint32_t backlog = 0u;      // байт нот/CC в очередях DIN
+    double next_event = 0.0;    // следующее событие педали
+    bool old_rt = false;        // старая схема: 0xF8 ждёт главного цикла
+    double old_rt_since = 0.0;
+
+    for (uint32_t k = 0u; k < TICKS; ++k) {
+        if (k == TICKS / 4u) {
+            for (uint32_t i = 0u; i < TAP_HISTORY; ++i) {
+                period_q8 = tp.tap(4348u + static_cast<uint32_t>(urand(-150.0, 150.0)));
+            }
+        }
+        const uint32_t arr = clock_next_arr(period_q8, frac);
+        const double t_next = t_tick + arr + 1u;
+        t_ideal += period_q8 / 256.0;
+
+        // Главный цикл и поток событий до следующего тика
+        for (;;) {
+            const double t = next_pass < next_event ? next_pass : next_event;
+            if (t >= t_next) {
+                break;
+            }
+            if (t == next_event) {
+                // Педаль: нота (3 байта) или CC (2 с running status); изредка
+                // очередь CC от экспрессии — пачка до 12 сообщений
+                const uint32_t add = (rng() & 7u) == 0u ? 2u * (1u + (rng() % 12u))
+                                                        : ((rng() & 1u) ? 3u : 2u);
+                backlog += add;
+                if (backlog > DIN_QUEUE_BYTES) {
+                    st.lost += backlog - DIN_QUEUE_BYTES; // очереди полны — лишнее теряется
+                    backlog = DIN_QUEUE_BYTES;
+                }
+                next_event = t + urand(2000.0, 15000.0);
+                continue;
+            }
+            next_pass = t + ((rng() & 15u) == 0u ? urand(LOOP_SHORT_MAX_US, LOOP_LONG_MAX_US)
+                                                 : urand(20.0, LOOP_SHORT_MAX_US));
+            if (t < dma_until) {
+                continue; // DMA ещё отдаёт блок
+            }
+            if (!new_scheme && old_rt) {
+                // Старая схема: 0xF8 первым в блоке из главного цикла
+                const double start = ln.write(t > ln.dr_until ? t : ln.dr_until);
+                const double j = fabs(start - old_rt_since);
+                if (j > st.din_max) st.din_max = j;
+                st.din_sum2 += j * j;
+                old_rt = false;
+                dma_until = start;
+            }
+            if (backlog == 0u) {
+                continue;
+            }
+            uint32_t max = DIN_BLOCK_MAX;
+            if (new_scheme) {
+                const double to_tick = t_next - t;
+                max = din_block_max(static_cast<uint32_t>(to_tick), ln.tc(t));
+            }
+            const uint32_t n = backlog < max ? backlog : max;
+            if (n == 0u) {
+                continue;
+            }
+            // Блок: байты идут подряд, EN снимается, когда последний отдан в DR
+            double start = 0.0;
+            double when = t;
+            for (uint32_t i = 0u; i < n; ++i) {
+                when = when > ln.dr_until ? when : ln.dr_until;
+                start = ln.write(when);
+            }
+            dma_until = n > 1u ? start - DIN_BYTE_US : t;
+            backlog -= n;
+            st.bytes += n;
+        }
+
+        // Тик
+        t_tick = t_next;
+        const double isr = t_tick + ISR_ENTRY_US + urand(0.0, IRQ_MASKED_MAX_US);
+        double usb = 0.0;
+        if (new_scheme) {
+            // USB: сразу в tx_ff; на записи главного цикла — по её окончании
+            usb = isr + ((rng() & 31u) == 0u ? urand(0.0, TX_WRITE_MAX_US) : 0.0);
+            // DIN: DR пуст и DMA стоит — сразу; иначе по TXE
+            double start;
+            if (isr >= dma_until && ln.txe(isr)) {
+                start = ln.write(isr);
+            }
+            else {
+                st.din_waited++;
+                const double txe = (dma_until > ln.dr_until ? dma_until : ln.dr_until) + ISR_ENTRY_US;
+                start = ln.write(txe > isr ? txe : isr);
+            }
+            const double j = fabs(start - t_ideal);
+            if (j > st.din_max) st.din_max = j;
+            st.din_sum2 += j * j;
+        }
+        else {
+            usb = next_pass + TX_WRITE_MAX_US / 2.0; // ближайший проход цикла
+            old_rt = true;
+            old_rt_since = t_ideal;
+        }
+        const double ju = fabs(usb - t_ideal);
+        if (ju > st.usb_max) st.usb_max = ju;
+        st.ticks++;
+    }
+    return st;
+}
+
+//--------------------------------------------------------------------+
+// Транспорт: busy снимается после Stop, Start / Continue запускают clock снова
+//--------------------------------------------------------------------+
+static void test_idle_stop() {
+    clock_run r;
+    CHECK(!r.busy(), "busy before the first tap");
+
+    const uint32_t t0 = 0xFFFF0000u; // через переполнение TIM5
+    r.tap(t0);
+    CHECK(r.busy() && r.running, "clock runs after taps");
+    CHECK(!r.set(MIDI_START, t0 + 10u, true), "Start with clock running restarts it");
+    CHECK(!r.expire(t0 + 100u * CLOCK_IDLE_TICKS), "clock stopped while playing");
+    CHECK(r.busy(), "not busy while playing");
+
+    const uint32_t t_stop = t0 + 100u * CLOCK_IDLE_TICKS + 7u;
+    CHECK(!r.set(MIDI_STOP, t_stop, true), "Stop starts the clock");
+    CHECK(r.busy(), "clock cut right at Stop");
+    CHECK(!r.expire(t_stop + CLOCK_IDLE_TICKS - 1u), "clock stopped before CLOCK_IDLE_TICKS");
+    CHECK(r.busy(), "busy dropped early");
+    CHECK(r.expire(t_stop + CLOCK_IDLE_TICKS), "clock not stopped after Stop");
+    CHECK(!r.busy() && !r.running, "busy after the clock stopped");
+    CHECK(!r.expire(t_stop + 2u * CLOCK_IDLE_TICKS), "clock stopped twice");
+
+    // Continue с известным темпом — TIM4 снова запускается
+    CHECK(r.set(MIDI_CONTINUE, t_stop + 3u * CLOCK_IDLE_TICKS, true), "Continue did not restart the clock");
+    CHECK(r.busy() && r.running, "not busy after Continue");
+
+    // Одни тапы без Start — clock тоже выдыхается, новый тап продлевает
+    clock_run taps;
+    taps.tap(100u);
+    taps.tap(100u + CLOCK_IDLE_TICKS - 1u);
+    CHECK(!taps.expire(100u + CLOCK_IDLE_TICKS + 5u), "a tap does not extend the clock");
+    CHECK(taps.expire(100u + 2u * CLOCK_IDLE_TICKS), "tapped clock never stops");
+    CHECK(!taps.busy(), "busy after the tapped clock stopped");
+
+    // Start без темпа: воспроизведение есть, clock запускать нечем
+    clock_run none;
+    CHECK(!none.set(MIDI_START, 0u, false), "clock started without a tempo");
+    CHECK(none.busy() && !none.running, "Start without a tempo");
+    CHECK(!none.set(MIDI_STOP, 1u, false) && !none.busy(), "busy after Stop without a clock");
+}
+
+int main(int argc, char** argv) {
+    const uint32_t seed = (argc > 1) ? static_cast<uint32_t>(strtoul(argv[1], nullptr, 0)) : 0x7e3b0c1du;
+
+    // Сетка TIM4: дробный период копится, фаза не уходит дальше 1 мкс
+    for (uint32_t dt = TAP_INTERVAL_MIN; dt <= TAP_INTERVAL_MAX; dt += 7u) {
+        const uint32_t err = clock_phase_error_q8(clock_period_q8(dt), 24u * 64u);
+        CHECK(err < 256u, "tap interval %u: phase error %u/256 us", dt, err);
+    }
+
+    test_idle_stop();
+
+    const stats now = run(true, seed);
+    const stats old = run(false, seed);
+
+    printf("midi clock, %u ticks, seed 0x%08lx\n", now.ticks, static_cast<unsigned long>(seed));
+    printf("  ISR emit:       USB max %6.1f us, DIN max %6.1f us (rms %.1f), DIN waited %u, DIN bytes %u lost %u\n",
+           now.usb_max, now.din_max, sqrt(now.din_sum2 / now.ticks), now.din_waited, now.bytes, now.lost);
+    printf("  main-loop emit: USB max %6.1f us, DIN max %6.1f us (rms %.1f), DIN bytes %u lost %u\n",
+           old.usb_max, old.din_max, sqrt(old.din_sum2 / old.ticks), old.bytes, old.lost);
+
+    CHECK(now.usb_max < JITTER_MAX_US, "USB jitter %.1f us", now.usb_max);
+    CHECK(now.din_max < JITTER_MAX_US, "DIN jitter %.1f us", now.din_max);
+    CHECK(now.din_waited == 0u, "0xF8 found the DIN line busy %u times", now.din_waited);
+    // Расписание по тикам не душит поток нот/CC: очереди не переполняются
+    CHECK(now.lost == 0u, "DIN lost %u bytes", now.lost);
+
+    printf("midi clock: %u failures\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+// Снимок перед STANDBY и очередь нажатий: Pedal_f411/snapshot.hpp, Pedal_f411/pedal_queue.hpp.
+//
+// Проверяет то, что snapshot_save()/snapshot_restore() делают поверх backup-регистров:
+// упаковку и разбор снимка и отказ при порче; а также переполнение очереди нажатий EXTI.
+
+#include <stdio.h>
+
+#include "snapshot.hpp"
+#include "pedal_queue.hpp"
+
+static unsigned failures;
+
+#define CHECK(_cond)                                                           \
+    do {                                                                       \
+        if (!(_cond)) {                                                        \
+            failures++;                                                        \
+            printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #_cond);             \
+        }                                                                      \
+    } while (0)
+
+static uint32_t ring_size(const RingBuf& q) {
+    return (q.write_idx - q.read_idx) & (RING_BUF_SIZE - 1u);
+}
+
+static void test_snapshot_roundtrip() {
+    const snapshot_t in = { 0x00123445u, 1000u, 3u };
+    uint32_t regs[SNAPSHOT_REGS] = {};
+    snapshot_pack(in, regs);
+    CHECK(regs[BKP_MAGIC] == SNAPSHOT_MAGIC);
+
+    snapshot_t out = {};
+    CHECK(snapshot_unpack(regs, out));
+    CHECK(out.adc == in.adc);
+    CHECK(out.standby_count == in.standby_count);
+    CHECK(out.adc_overruns == in.adc_overruns);
+}
+
+static void test_snapshot_corrupt() {
+    const snapshot_t in = { 0x00ABCD12u, 42u, 0u };
+    uint32_t regs[SNAPSHOT_REGS] = {};
+    snapshot_pack(in, regs);
+
+    // Любой перевёрнутый бит, включая саму контрольную сумму
+    unsigned accepted = 0u;
+    for (uint8_t r = 0u; r < SNAPSHOT_REGS; ++r) {
+        for (uint32_t bit = 0u; bit < 32u; ++bit) {
+            uint32_t bad[SNAPSHOT_REGS];
+            for (uint8_t i = 0u; i < SNAPSHOT_REGS; ++i) bad[i] = regs[i];
+            bad[r] ^= 1u << bit;
+            snapshot_t out = { 1u, 4u, 5u };
+            if (snapshot_unpack(bad, out)) ++accepted;
+            // При отказе снимок не трогает выход
+            CHECK(out.adc == 1u && out.adc_overruns == 5u);
+        }
+    }
+    CHECK(accepted == 0u);
+
+    // Чужая раскладка с верной суммой — холодный старт
+    regs[BKP_MAGIC] = SNAPSHOT_MAGIC + 1u;
+    regs[BKP_CHECKSUM] = snapshot_checksum(regs);
+    snapshot_t out = {};
+    CHECK(!snapshot_unpack(regs, out));
+
+    // Сброс по питанию: регистры обнулены
+    uint32_t zero[SNAPSHOT_REGS] = {};
+    CHECK(!snapshot_unpack(zero, out));
+}
+
+static void test_queue_overflow() {
+    // Очередь держит RING_BUF_SIZE - 1 событий, лишние теряются; индексы заворачиваются
+    RingBuf q;
+    for (uint32_t i = 0u; i < 5u; ++i) {
+        q.push({ pedal_type::a, i, pedal_condition::pressed });
+        q.pop_front();
+    }
+    for (uint32_t i = 0u; i < RING_BUF_SIZE + 3u; ++i) {
+        q.push({ static_cast<pedal_type>(1u << (i & 3u)), i, pedal_condition::worked });
+    }
+    CHECK(ring_size(q) == RING_BUF_SIZE - 1u);
+    for (uint32_t i = 0u; !q.empty(); ++i) {
+        CHECK(q.front().ped == static_cast<pedal_type>(1u << (i & 3u)));
+        CHECK(q.front().time == i);
+        q.pop_front();
+    }
+}
+
+int main() {
+    test_snapshot_roundtrip();
+    test_snapshot_corrupt();
+    test_queue_overflow();
+
+    printf("snapshot: %u failures\n", failures);
+    return failures ? 1 : 0;
+}
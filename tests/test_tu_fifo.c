@@ -0,0 +1,274 @@
+// Randomized check of tinyusb/src/common/tusb_fifo.c against a plain reference queue.
+//
+// Covers both index paths (power-of-two depth masks and the generic modulo logic),
+// the word copy in _ff_memcpy() (item sizes and lengths that are and are not
+// a multiple of 4), wrap-around of every copy, and the overwritable FIFO including
+// the single-overflow recovery in read/peek.
+//
+//   test_tu_fifo [seed]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "osal/osal.h"
+#include "common/tusb_fifo.h"
+
+#define DEPTH_MAX       1024
+#define ITEM_MAX        8
+#define OPS_PER_CASE    4000
+
+static uint32_t rng_state;
+
+static uint32_t rng(void)
+{
+  // xorshift32: reproducible across hosts for a given seed
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+  return rng_state;
+}
+
+static uint32_t rng_below(uint32_t n)
+{
+  return n ? rng() % n : 0;
+}
+
+//--------------------------------------------------------------------+
+// Reference queue: items are kept in order, oldest first
+//--------------------------------------------------------------------+
+typedef struct
+{
+  uint8_t  data[2 * DEPTH_MAX * ITEM_MAX];
+  uint32_t count;   // items held
+  uint32_t raw;     // items written since the last read index correction
+} model_t;
+
+static void model_push(model_t* m, uint16_t depth, uint16_t item_size, uint8_t const* src, uint32_t n)
+{
+  memcpy(m->data + m->count * item_size, src, n * item_size);
+  m->count += n;
+  m->raw   += n;
+
+  // Overwritable FIFO keeps the newest depth items
+  if ( m->count > depth )
+  {
+    uint32_t const drop = m->count - depth;
+    memmove(m->data, m->data + drop * item_size, depth * item_size);
+    m->count = depth;
+  }
+}
+
+static void model_pop(model_t* m, uint16_t item_size, uint32_t n)
+{
+  memmove(m->data, m->data + n * item_size, (m->count - n) * item_size);
+  m->count -= n;
+  m->raw    = m->count;
+}
+
+//--------------------------------------------------------------------+
+// Checks
+//--------------------------------------------------------------------+
+static unsigned failures;
+static char const* case_name;
+
+#define CHECK(_cond, ...)                                                      \
+  do {                                                                         \
+    if ( !(_cond) )                                                            \
+    {                                                                          \
+      failures++;                                                              \
+      printf("FAIL %s:%d %s (%s): ", __FILE__, __LINE__, case_name, #_cond);   \
+      printf(__VA_ARGS__);                                                     \
+      printf("\n");                                                            \
+      return false;                                                            \
+    }                                                                          \
+  } while (0)
+
+static bool check_state(tu_fifo_t* f, model_t const* m, uint16_t depth)
+{
+  uint16_t const count = tu_fifo_count(f);
+  CHECK(count == m->count, "count %u, expected %u", count, (unsigned) m->count);
+  CHECK(tu_fifo_empty(f) == (m->count == 0), "empty, count %u", (unsigned) m->count);
+  CHECK(tu_fifo_full(f) == (m->count == depth), "full, count %u", (unsigned) m->count);
+  CHECK(tu_fifo_remaining(f) == depth - m->count, "remaining %u", tu_fifo_remaining(f));
+  CHECK(tu_fifo_overflowed(f) == (m->raw > depth), "overflowed, raw %u", (unsigned) m->raw);
+  return true;
+}
+
+static void fill(uint8_t* buf, uint32_t bytes, uint8_t* seq)
+{
+  for ( uint32_t i = 0; i < bytes; i++ ) buf[i] = (*seq)++;
+}
+
+//--------------------------------------------------------------------+
+// One configuration: depth x item size x overwritable
+//--------------------------------------------------------------------+
+static bool run_case(uint16_t depth, uint16_t item_size, bool overwritable)
+{
+  static uint32_t ff_buf[DEPTH_MAX * ITEM_MAX / 4];   // word aligned, as the MIDI FIFOs
+  static uint8_t  src[2 * DEPTH_MAX * ITEM_MAX];
+  static uint8_t  dst[2 * DEPTH_MAX * ITEM_MAX];
+  static model_t  m;
+
+  char name[64];
+  snprintf(name, sizeof(name), "depth %u item %u%s", depth, item_size, overwritable ? " overwritable" : "");
+  case_name = name;
+
+  tu_fifo_t f;
+  CHECK(tu_fifo_config(&f, ff_buf, depth, item_size, overwritable), "config");
+  memset(&m, 0, sizeof(m));
+  uint8_t seq = 0;
+
+  for ( unsigned op = 0; op < OPS_PER_CASE; op++ )
+  {
+    // Bursts up to 2 x depth: hit partial, exact and oversized writes/reads
+    uint16_t n = (uint16_t) (1 + rng_below(2u * depth));
+
+    switch ( rng_below(9) )
+    {
+      case 0: // single write
+      {
+        // Overwritable: single overflow only, a double overflow loses data by design
+        if ( overwritable && m.raw + 1 >= 2u * depth ) break;
+        fill(src, item_size, &seq);
+        bool const ok = tu_fifo_write(&f, src);
+        bool const expect = overwritable || m.count < depth;
+        CHECK(ok == expect, "write returned %d", ok);
+        if ( ok ) model_push(&m, depth, item_size, src, 1);
+      }
+      break;
+
+      case 1: // write_n
+      case 2:
+      {
+        if ( overwritable && n < depth && m.raw + n >= 2u * depth ) break;
+        fill(src, (uint32_t) n * item_size, &seq);
+        uint16_t const wrote = tu_fifo_write_n(&f, src, n);
+        if ( overwritable )
+        {
+          CHECK(wrote == (n < depth ? n : depth), "write_n %u wrote %u", n, wrote);
+          if ( n >= depth )
+          {
+            // Whole buffer rewritten from the read index: no pending overflow
+            model_push(&m, depth, item_size, src + (uint32_t) (n - depth) * item_size, depth);
+            m.raw = depth;
+          }
+          else
+          {
+            model_push(&m, depth, item_size, src, n);
+          }
+        }
+        else
+        {
+          uint16_t const room = (uint16_t) (depth - m.count);
+          CHECK(wrote == (n < room ? n : room), "write_n %u wrote %u room %u", n, wrote, room);
+          model_push(&m, depth, item_size, src, wrote);
+        }
+      }
+      break;
+
+      case 3: // single read
+      {
+        bool const ok = tu_fifo_read(&f, dst);
+        CHECK(ok == (m.count > 0), "read returned %d", ok);
+        if ( ok )
+        {
+          CHECK(memcmp(dst, m.data, item_size) == 0, "read data");
+          model_pop(&m, item_size, 1);
+        }
+      }
+      break;
+
+      case 4: // read_n
+      case 5:
+      {
+        uint16_t const got = tu_fifo_read_n(&f, dst, n);
+        uint16_t const expect = (uint16_t) (n < m.count ? n : m.count);
+        CHECK(got == expect, "read_n %u got %u", n, got);
+        CHECK(memcmp(dst, m.data, (uint32_t) got * item_size) == 0, "read_n data, %u items", got);
+        if ( got ) model_pop(&m, item_size, got);
+        else m.raw = 0;
+      }
+      break;
+
+      case 6: // peek / peek_n leave the data in place
+      {
+        if ( rng() & 1 )
+        {
+          bool const ok = tu_fifo_peek(&f, dst);
+          CHECK(ok == (m.count > 0), "peek returned %d", ok);
+          if ( ok ) CHECK(memcmp(dst, m.data, item_size) == 0, "peek data");
+        }
+        else
+        {
+          uint16_t const got = tu_fifo_peek_n(&f, dst, n);
+          uint16_t const expect = (uint16_t) (n < m.count ? n : m.count);
+          CHECK(got == expect, "peek_n %u got %u", n, got);
+          CHECK(memcmp(dst, m.data, (uint32_t) got * item_size) == 0, "peek_n data");
+        }
+        // Peek corrects an overflowed read index
+        if ( m.count ) m.raw = m.count;
+      }
+      break;
+
+      case 7: // linear/wrap info + advance, as the DWC2 driver drains the FIFO
+      {
+        // Pointers are byte offsets: valid for item_size 1 only
+        if ( item_size != 1 ) break;
+        tu_fifo_buffer_info_t info;
+        tu_fifo_get_read_info(&f, &info);
+        if ( m.count ) m.raw = m.count;
+        CHECK(info.len_lin + info.len_wrap == m.count, "read info %u + %u", info.len_lin, info.len_wrap);
+        if ( info.len_lin ) CHECK(memcmp(info.ptr_lin, m.data, info.len_lin) == 0, "read info linear data");
+        if ( info.len_wrap ) CHECK(memcmp(info.ptr_wrap, m.data + info.len_lin, info.len_wrap) == 0, "read info wrap data");
+        uint16_t const adv = (uint16_t) rng_below(m.count + 1u);
+        tu_fifo_advance_read_pointer(&f, adv);
+        if ( adv ) model_pop(&m, item_size, adv);
+      }
+      break;
+
+      default: // rare clear
+        if ( rng_below(16) == 0 )
+        {
+          tu_fifo_clear(&f);
+          m.count = 0;
+          m.raw   = 0;
+        }
+      break;
+    }
+
+    if ( !check_state(&f, &m, depth) ) return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t const seed = (argc > 1) ? (uint32_t) strtoul(argv[1], NULL, 0) : 0x5eed1234u;
+  rng_state = seed ? seed : 1;
+
+  static uint16_t const item_sizes[] = { 1, 2, 3, 4, 8 };
+  static uint16_t const big_depths[] = { 128, 255, 256, 257, 1024 };
+  unsigned cases = 0;
+
+  for ( unsigned o = 0; o < 2; o++ )
+  {
+    for ( unsigned s = 0; s < sizeof(item_sizes) / sizeof(item_sizes[0]); s++ )
+    {
+      for ( uint16_t depth = 1; depth <= 70; depth++ )
+      {
+        run_case(depth, item_sizes[s], o);
+        cases++;
+      }
+      for ( unsigned d = 0; d < sizeof(big_depths) / sizeof(big_depths[0]); d++ )
+      {
+        run_case(big_depths[d], item_sizes[s], o);
+        cases++;
+      }
+    }
+  }
+
+  printf("tu_fifo: %u cases, seed 0x%08lx, %u failures\n", cases, (unsigned long) seed, failures);
+  return failures ? 1 : 0;
+}
@@ -53,6 +53,16 @@ typedef enum {
   MIDI_CS_ENDPOINT_GENERAL_2_0 = 0x02,
 } midi_cs_endpoint_subtype_t;
 
+// USB-MIDI 2.0: Group Terminal Block descriptor
+enum {
+  MIDI_CS_GR_TRM_BLOCK = 0x26,
+};
+
+typedef enum {
+  MIDI_GR_TRM_BLOCK_HEADER = 0x01,
+  MIDI_GR_TRM_BLOCK        = 0x02,
+} midi_gr_trm_block_subtype_t;
+
 typedef enum {
   MIDI_JACK_EMBEDDED = 0x01,
   MIDI_JACK_EXTERNAL = 0x02
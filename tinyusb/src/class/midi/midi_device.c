@@ -44,18 +44,31 @@ typedef struct {
   uint8_t ep_in;
   uint8_t ep_out;
 
+  #if CFG_TUD_MIDI_UMP
+  uint8_t alt; // 0: USB-MIDI 1.0, 1: UMP
+  #endif
+
   // For Stream read()/write() API
   // Messages are always 4 bytes long, queue them for reading and writing so the
   // callers can use the Stream interface with single-byte read/write calls.
   midi_driver_stream_t stream_write;
   midi_driver_stream_t stream_read;
 
+  #if CFG_TUD_MIDI_TX_SOF_SYNC
+  volatile uint8_t zlp_pending; // last IN transfer was a multiple of EP size, ep_in is claimed for the ZLP
+  #endif
+
+  #if CFG_TUD_MIDI_UMP
+  volatile uint8_t tx_frozen; // SET_INTERFACE is flushing tx_ff: tud_midi_n_write_isr() refuses
+  #endif
+
   /*------------- From this point, data is not cleared by bus reset -------------*/
   // FIFO
   tu_fifo_t rx_ff;
   tu_fifo_t tx_ff;
-  uint8_t rx_ff_buf[CFG_TUD_MIDI_RX_BUFSIZE];
-  uint8_t tx_ff_buf[CFG_TUD_MIDI_TX_BUFSIZE];
+  // word aligned: 4-byte packets are copied in and out as whole words
+  TU_ATTR_ALIGNED(4) uint8_t rx_ff_buf[CFG_TUD_MIDI_RX_BUFSIZE];
+  TU_ATTR_ALIGNED(4) uint8_t tx_ff_buf[CFG_TUD_MIDI_TX_BUFSIZE];
 
   #if CFG_FIFO_MUTEX
   osal_mutex_def_t rx_ff_mutex;
@@ -67,7 +80,9 @@ typedef struct {
 
 // Endpoint Transfer buffer
 CFG_TUD_MEM_SECTION static struct {
+  #if !CFG_TUD_MIDI_TX_XFER_FIFO
   TUD_EPBUF_DEF(epin, CFG_TUD_MIDI_EP_BUFSIZE);
+  #endif
   TUD_EPBUF_DEF(epout, CFG_TUD_MIDI_EP_BUFSIZE);
 } _midid_epbuf[CFG_TUD_MIDI];
 
@@ -195,6 +210,9 @@ bool tud_midi_n_packet_read (uint8_t itf, uint8_t packet[4])
 {
   midid_interface_t* midi = &_midid_itf[itf];
   TU_VERIFY(midi->ep_out);
+  #if CFG_TUD_MIDI_UMP
+  TU_VERIFY(midi->alt == 0);
+  #endif
 
   const uint32_t num_read = tu_fifo_read_n(&midi->rx_ff, packet, 4);
   _prep_out_transaction(itf);
@@ -217,10 +235,20 @@ static uint32_t write_flush(uint8_t idx) {
   // skip if previous transfer not complete
   TU_VERIFY( usbd_edpt_claim(rhport, midi->ep_in), 0 );
 
+  #if CFG_TUD_MIDI_TX_XFER_FIFO
+  // Data stays in tx_ff until the DCD pulls it into the hardware FIFO,
+  // so tu_fifo_remaining() keeps accounting for in-flight bytes
+  uint16_t count = tu_min16(tu_fifo_count(&midi->tx_ff), CFG_TUD_MIDI_EP_BUFSIZE);
+  #else
   uint16_t count = tu_fifo_read_n(&midi->tx_ff, _midid_epbuf[idx].epin, CFG_TUD_MIDI_EP_BUFSIZE);
+  #endif
 
   if (count) {
+    #if CFG_TUD_MIDI_TX_XFER_FIFO
+    TU_ASSERT( usbd_edpt_xfer_fifo(rhport, midi->ep_in, &midi->tx_ff, count), 0 );
+    #else
     TU_ASSERT( usbd_edpt_xfer(rhport, midi->ep_in, _midid_epbuf[idx].epin, count), 0 );
+    #endif
     return count;
   }else {
     // Release endpoint since we don't make any transfer
@@ -233,6 +261,9 @@ uint32_t tud_midi_n_stream_write(uint8_t itf, uint8_t cable_num, const uint8_t*
 {
   midid_interface_t* midi = &_midid_itf[itf];
   TU_VERIFY(midi->ep_in, 0);
+  #if CFG_TUD_MIDI_UMP
+  TU_VERIFY(midi->alt == 0, 0);
+  #endif
 
   midi_driver_stream_t* stream = &midi->stream_write;
 
@@ -344,7 +375,9 @@ uint32_t tud_midi_n_stream_write(uint8_t itf, uint8_t cable_num, const uint8_t*
     }
   }
 
+  #if !CFG_TUD_MIDI_TX_SOF_SYNC
   write_flush(itf);
+  #endif
 
   return i;
 }
@@ -352,17 +385,89 @@ uint32_t tud_midi_n_stream_write(uint8_t itf, uint8_t cable_num, const uint8_t*
 bool tud_midi_n_packet_write (uint8_t itf, const uint8_t packet[4]) {
   midid_interface_t* midi = &_midid_itf[itf];
   TU_VERIFY(midi->ep_in);
+  #if CFG_TUD_MIDI_UMP
+  TU_VERIFY(midi->alt == 0);
+  #endif
 
   if (tu_fifo_remaining(&midi->tx_ff) < 4) {
     return false;
   }
 
   tu_fifo_write_n(&midi->tx_ff, packet, 4);
+  #if !CFG_TUD_MIDI_TX_SOF_SYNC
   write_flush(itf);
+  #endif
+
+  return true;
+}
+
+bool tud_midi_n_write_isr (uint8_t itf, void const* buffer, uint32_t bufsize) {
+  midid_interface_t* midi = &_midid_itf[itf];
+  // ep_in is cleared first on bus reset, before tx_ff
+  TU_VERIFY(midi->ep_in && bufsize && (bufsize % 4) == 0);
+  #if CFG_TUD_MIDI_UMP
+  TU_VERIFY(!midi->tx_frozen);
+  #endif
+
+  if (tu_fifo_remaining(&midi->tx_ff) < bufsize) {
+    return false;
+  }
 
+  tu_fifo_write_n(&midi->tx_ff, buffer, (uint16_t) bufsize);
   return true;
 }
 
+uint32_t tud_midi_n_write_flush (uint8_t itf) {
+  #if CFG_TUD_MIDI_TX_SOF_SYNC
+  (void) itf;
+  return 0;
+  #else
+  TU_VERIFY(_midid_itf[itf].ep_in, 0);
+  return write_flush(itf);
+  #endif
+}
+
+#if CFG_TUD_MIDI_UMP
+bool tud_midi_n_ump_mode (uint8_t itf) {
+  return _midid_itf[itf].alt == 1;
+}
+
+uint32_t tud_midi_n_ump_write (uint8_t itf, uint32_t const* words, uint32_t count) {
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->ep_in && midi->alt == 1, 0);
+
+  const uint32_t bytes = 4 * count;
+  if (tu_fifo_remaining(&midi->tx_ff) < bytes) {
+    return 0;
+  }
+
+  tu_fifo_write_n(&midi->tx_ff, words, (uint16_t) bytes);
+  #if !CFG_TUD_MIDI_TX_SOF_SYNC
+  write_flush(itf);
+  #endif
+
+  return count;
+}
+
+uint32_t tud_midi_n_ump_read (uint8_t itf, uint32_t words[4]) {
+  // UMP size in words, indexed by Message Type (M2-104-UM)
+  static const uint8_t ump_words[16] = { 1, 1, 1, 2, 2, 4, 1, 1, 2, 2, 2, 3, 3, 4, 4, 4 };
+
+  midid_interface_t* midi = &_midid_itf[itf];
+  TU_VERIFY(midi->ep_out && midi->alt == 1, 0);
+
+  uint32_t head;
+  TU_VERIFY(tu_fifo_peek_n(&midi->rx_ff, &head, 4) == 4, 0);
+  const uint32_t count = ump_words[head >> 28];
+  // a message split across two OUT transfers: wait for the rest
+  TU_VERIFY(tu_fifo_count(&midi->rx_ff) >= 4 * count, 0);
+
+  tu_fifo_read_n(&midi->rx_ff, words, (uint16_t) (4 * count));
+  _prep_out_transaction(itf);
+  return count;
+}
+#endif
+
 //--------------------------------------------------------------------+
 // USBD Driver API
 //--------------------------------------------------------------------+
@@ -461,6 +566,13 @@ uint16_t midid_open(uint8_t rhport, const tusb_desc_interface_t* desc_itf, uint1
   p_midi->itf_num = desc_midi->bInterfaceNumber;
   (void) p_midi->itf_num;
 
+  // tx_ff is empty after bus reset: its depth may follow the configuration
+  if (tud_midi_tx_bufsize_cb) {
+    const uint16_t depth = tud_midi_tx_bufsize_cb(idx);
+    TU_ASSERT(depth && depth <= CFG_TUD_MIDI_TX_BUFSIZE, 0);
+    tu_fifo_config(&p_midi->tx_ff, p_midi->tx_ff_buf, depth, 1, false);
+  }
+
   // next descriptor
   drv_len += tu_desc_len(p_desc);
   p_desc   = tu_desc_next(p_desc);
@@ -492,9 +604,25 @@ uint16_t midid_open(uint8_t rhport, const tusb_desc_interface_t* desc_itf, uint1
     p_desc   = tu_desc_next(p_desc);
   }
 
+  #if CFG_TUD_MIDI_UMP
+  // Alternate settings of the same interface (USB-MIDI 2.0) reuse the endpoints
+  // opened above: claim their descriptors so usbd does not look for another driver
+  while ((drv_len < max_len) && (TUSB_DESC_INTERFACE == tu_desc_type(p_desc)) &&
+         (((const tusb_desc_interface_t*) p_desc)->bInterfaceNumber == desc_midi->bInterfaceNumber)) {
+    do {
+      drv_len += tu_desc_len(p_desc);
+      p_desc   = tu_desc_next(p_desc);
+    } while ((drv_len < max_len) && (TUSB_DESC_INTERFACE != tu_desc_type(p_desc)));
+  }
+  #endif
+
   // Prepare for incoming data
   _prep_out_transaction(idx);
 
+  #if CFG_TUD_MIDI_TX_SOF_SYNC
+  usbd_sof_enable(rhport, SOF_CONSUMER_MIDI, true);
+  #endif
+
   return drv_len;
 }
 
@@ -502,8 +630,83 @@ uint16_t midid_open(uint8_t rhport, const tusb_desc_interface_t* desc_itf, uint1
 // Driver response accordingly to the request and the transfer stage (setup/data/ack)
 // return false to stall control endpoint (e.g unsupported request)
 bool midid_control_xfer_cb(uint8_t rhport, uint8_t stage, const tusb_control_request_t* request) {
+  #if CFG_TUD_MIDI_UMP
+  TU_VERIFY(request->bmRequestType_bit.type == TUSB_REQ_TYPE_STANDARD &&
+            request->bmRequestType_bit.recipient == TUSB_REQ_RCPT_INTERFACE);
+
+  uint8_t idx;
+  for (idx = 0; idx < CFG_TUD_MIDI; idx++) {
+    if (_midid_itf[idx].ep_in && _midid_itf[idx].itf_num == tu_u16_low(request->wIndex)) {
+      break;
+    }
+  }
+  // Audio Control interface: usbd answers GET/SET_INTERFACE itself
+  TU_VERIFY(idx < CFG_TUD_MIDI);
+  midid_interface_t* p_midi = &_midid_itf[idx];
+
+  if (stage != CONTROL_STAGE_SETUP) {
+    return true;
+  }
+
+  switch (request->bRequest) {
+    case TUSB_REQ_GET_INTERFACE:
+      return tud_control_xfer(rhport, request, &p_midi->alt, 1);
+
+    case TUSB_REQ_SET_INTERFACE: {
+      const uint8_t alt = tu_u16_low(request->wValue);
+      TU_VERIFY(alt <= 1);
+      if (alt != p_midi->alt) {
+        // Queued data is in the other format and must never reach the host.
+        // With the USB interrupt masked neither the SOF ISR nor the TXFE handler
+        // can arm or feed the IN endpoint while it is reset.
+        usbd_int_set(false);
+        // An interrupt-context writer (tud_midi_n_write_isr) preempts this code:
+        // it must not add old-format data after the flush
+        p_midi->tx_frozen = 1;
+        if (usbd_edpt_busy(rhport, p_midi->ep_in)) {
+          // Abort the transfer in flight: stall + clear disables the endpoint,
+          // flushes its hardware FIFO and resets the data toggle as SET_INTERFACE
+          // requires. The aborted transfer reports no completion.
+          usbd_edpt_stall(rhport, p_midi->ep_in);
+          usbd_edpt_clear_stall(rhport, p_midi->ep_in);
+        }
+        tu_fifo_clear(&p_midi->tx_ff);
+        #if CFG_TUD_MIDI_TX_SOF_SYNC
+        if (p_midi->zlp_pending) {
+          // The ZLP ended a transfer of the old format: drop it with its claim
+          p_midi->zlp_pending = 0;
+          usbd_edpt_release(rhport, p_midi->ep_in);
+        }
+        #endif
+        p_midi->alt = alt;
+        p_midi->tx_frozen = 0;
+        usbd_int_set(true);
+        tu_memclr(&p_midi->stream_write, sizeof(p_midi->stream_write));
+        tu_memclr(&p_midi->stream_read, sizeof(p_midi->stream_read));
+        tu_fifo_clear(&p_midi->rx_ff);
+        if (tud_midi_alt_cb) {
+          tud_midi_alt_cb(idx, alt);
+        }
+      }
+      return tud_control_status(rhport, request);
+    }
+
+    case TUSB_REQ_GET_DESCRIPTOR:
+      if (tu_u16_high(request->wValue) == MIDI_CS_GR_TRM_BLOCK) {
+        uint16_t len = 0;
+        uint8_t const* desc = tud_midi_descriptor_group_terminal_block_cb(idx, &len);
+        TU_VERIFY(desc);
+        return tud_control_xfer(rhport, request, (void*) (uintptr_t) desc, tu_min16(len, request->wLength));
+      }
+      return false;
+
+    default:
+      return false;
+  }
+  #else
   (void) rhport; (void) stage; (void) request;
   return false; // driver doesn't support any request yet
+  #endif
 }
 
 bool midid_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
@@ -537,6 +740,15 @@ bool midid_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32
     // and does not need to claim like ep_in
     _prep_out_transaction(idx);
   } else if (ep_addr == p_midi->ep_in) {
+    #if CFG_TUD_MIDI_TX_SOF_SYNC
+    // Next packet (or ZLP) is armed from midid_sof_isr(). The endpoint is claimed
+    // before the flag is raised: from here the SOF ISR cannot arm new data ahead
+    // of the ZLP, and the flag is only cleared by the side that owns the claim.
+    if (xferred_bytes && (0 == (xferred_bytes % CFG_TUD_MIDI_EP_BUFSIZE)) &&
+        usbd_edpt_claim(rhport, p_midi->ep_in)) {
+      p_midi->zlp_pending = 1;
+    }
+    #else
     if (0 == write_flush(idx)) {
       // If there is no data left, a ZLP should be sent if
       // xferred_bytes is multiple of EP size and not zero
@@ -546,9 +758,34 @@ bool midid_xfer_cb(uint8_t rhport, uint8_t ep_addr, xfer_result_t result, uint32
         }
       }
     }
+    #endif
   }
 
   return true;
 }
 
+#if CFG_TUD_MIDI_TX_SOF_SYNC
+// Invoked in ISR context on every SOF. The IN endpoint is only armed here, so
+// the application side just fills tx_ff and never races on the endpoint.
+// A pending ZLP already holds the claim (midid_xfer_cb) and goes out first;
+// queued data follows on the next SOF.
+void midid_sof_isr(uint8_t rhport, uint32_t frame_count) {
+  (void) frame_count;
+
+  for (uint8_t idx = 0; idx < CFG_TUD_MIDI; idx++) {
+    midid_interface_t* p_midi = &_midid_itf[idx];
+    if (!p_midi->ep_in) {
+      continue;
+    }
+
+    if (p_midi->zlp_pending) {
+      p_midi->zlp_pending = 0;
+      usbd_edpt_xfer(rhport, p_midi->ep_in, NULL, 0);
+    } else {
+      (void) write_flush(idx);
+    }
+  }
+}
+#endif
+
 #endif
@@ -43,6 +43,30 @@
   #define CFG_TUD_MIDI_EP_BUFSIZE     (TUD_OPT_HIGH_SPEED ? 512 : 64)
 #endif
 
+// Arm IN transfers from the SOF interrupt instead of on every write.
+// Events written during a frame are batched into one packet that is ready
+// before the host's next IN token.
+#ifndef CFG_TUD_MIDI_TX_SOF_SYNC
+  #define CFG_TUD_MIDI_TX_SOF_SYNC    0
+#endif
+
+// Transmit straight from tx_ff into the controller's TX FIFO with
+// dcd_edpt_xfer_fifo(), skipping the intermediate endpoint buffer copy.
+// Requires a DCD that implements dcd_edpt_xfer_fifo() for IN endpoints
+// (e.g. DWC2 in slave mode).
+#ifndef CFG_TUD_MIDI_TX_XFER_FIFO
+  #define CFG_TUD_MIDI_TX_XFER_FIFO   0
+#endif
+
+// USB-MIDI 2.0: MIDI Streaming interface has alternate setting 1 that carries
+// Universal MIDI Packets on the same endpoints. The host selects it with
+// SET_INTERFACE; otherwise alt 0 (USB-MIDI 1.0 event packets) stays active.
+// The application supplies the Group Terminal Block descriptor via
+// tud_midi_descriptor_group_terminal_block_cb().
+#ifndef CFG_TUD_MIDI_UMP
+  #define CFG_TUD_MIDI_UMP            0
+#endif
+
 #ifdef __cplusplus
  extern "C" {
 #endif
@@ -75,6 +99,32 @@ bool     tud_midi_n_packet_read  (uint8_t itf, uint8_t packet[4]);
 // Write event packet            (4 bytes)
 bool     tud_midi_n_packet_write (uint8_t itf, uint8_t const packet[4]);
 
+// Copy whole 4-byte packets or UMP words into tx_ff from interrupt context, e.g. a
+// timer ISR sending System Real-Time. The endpoint is left alone: data is sent by the
+// next write/flush from task context, or by the SOF ISR with CFG_TUD_MIDI_TX_SOF_SYNC.
+// The caller must be the only tx_ff writer while it runs (task-context writes may not
+// be in progress) and picks the format for the active alternate setting.
+// Returns false if not mounted, the alternate setting is being switched or tx_ff is full.
+bool     tud_midi_n_write_isr    (uint8_t itf, void const* buffer, uint32_t bufsize);
+
+// Arm the IN endpoint with data already in tx_ff (task context). Returns bytes armed.
+// No-op with CFG_TUD_MIDI_TX_SOF_SYNC: the SOF ISR arms the endpoint.
+uint32_t tud_midi_n_write_flush  (uint8_t itf);
+
+#if CFG_TUD_MIDI_UMP
+// Host selected alternate setting 1: UMP instead of USB-MIDI 1.0 event packets.
+// Stream/packet API is refused while UMP is active.
+bool     tud_midi_n_ump_mode     (uint8_t itf);
+
+// Write whole UMP messages (32-bit words, native order). Returns count, or 0 if
+// they don't all fit: a message is never split across the FIFO boundary.
+uint32_t tud_midi_n_ump_write    (uint8_t itf, uint32_t const* words, uint32_t count);
+
+// Read one whole UMP message (1..4 words, size from the Message Type).
+// Returns its word count, or 0 if no complete message is buffered.
+uint32_t tud_midi_n_ump_read     (uint8_t itf, uint32_t words[4]);
+#endif
+
 //--------------------------------------------------------------------+
 // Application API (Single Interface)
 //--------------------------------------------------------------------+
@@ -120,6 +170,18 @@ static inline bool tud_midi_receive(uint8_t packet[4])
 //--------------------------------------------------------------------+
 TU_ATTR_WEAK void tud_midi_rx_cb(uint8_t itf);
 
+// Invoked when the MIDI Streaming interface is opened (SET_CONFIGURATION): depth
+// of tx_ff for this configuration, at most CFG_TUD_MIDI_TX_BUFSIZE
+TU_ATTR_WEAK uint16_t tud_midi_tx_bufsize_cb(uint8_t itf);
+
+#if CFG_TUD_MIDI_UMP
+// Invoked on GET_DESCRIPTOR (CS_GR_TRM_BLOCK) for the MIDI Streaming interface
+uint8_t const* tud_midi_descriptor_group_terminal_block_cb(uint8_t itf, uint16_t* len);
+
+// Invoked when the host switches between USB-MIDI 1.0 (alt 0) and UMP (alt 1)
+TU_ATTR_WEAK void tud_midi_alt_cb(uint8_t itf, uint8_t alt);
+#endif
+
 //--------------------------------------------------------------------+
 // Inline Functions
 //--------------------------------------------------------------------+
@@ -163,6 +225,7 @@ void     midid_reset           (uint8_t rhport);
 uint16_t midid_open            (uint8_t rhport, tusb_desc_interface_t const * itf_desc, uint16_t max_len);
 bool     midid_control_xfer_cb (uint8_t rhport, uint8_t stage, tusb_control_request_t const * request);
 bool     midid_xfer_cb         (uint8_t rhport, uint8_t edpt_addr, xfer_result_t result, uint32_t xferred_bytes);
+void     midid_sof_isr         (uint8_t rhport, uint32_t frame_count);
 
 #ifdef __cplusplus
  }
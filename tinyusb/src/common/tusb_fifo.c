@@ -55,6 +55,16 @@ TU_ATTR_ALWAYS_INLINE static inline void _ff_unlock(osal_mutex_t mutex)
 
 #endif
 
+// Compiler barrier: item data must be stored before the index that publishes it
+// (and consumed before the index that releases it). Keeps the non-overwritable
+// FIFO lock-free for a single producer and a single consumer, e.g. an ISR writer
+// and a main-loop reader on the same core.
+#if defined(__GNUC__)
+  #define _ff_barrier()   __asm__ volatile ("" ::: "memory")
+#else
+  #define _ff_barrier()
+#endif
+
 /** \enum tu_fifo_copy_mode_t
  * \brief Write modes intended to allow special read and write functions to be able to
  *        copy data to and from USB hardware FIFOs as needed for e.g. STM32s and others
@@ -145,10 +155,32 @@ static void _ff_pull_const_addr(void * app_buf, const uint8_t * ff_buf, uint16_t
 }
 #endif
 
+// memcpy() for the incrementing copy mode. Lengths that are a multiple of 4 are
+// moved as whole words: every MIDI packet is 4 bytes and e.g. newlib-nano's
+// memcpy() is a plain byte loop.
+TU_ATTR_ALWAYS_INLINE static inline void _ff_memcpy(void * dst, const void * src, uint16_t len)
+{
+  if ( (len & 0x03) == 0 )
+  {
+    uint8_t* dst8 = (uint8_t*) dst;
+    uint8_t const* src8 = (uint8_t const*) src;
+    for(uint16_t words = len >> 2; words; words--)
+    {
+      tu_unaligned_write32(dst8, tu_unaligned_read32(src8));
+      dst8 += 4;
+      src8 += 4;
+    }
+  }
+  else
+  {
+    memcpy(dst, src, len);
+  }
+}
+
 // send one item to fifo WITHOUT updating write pointer
 static inline void _ff_push(tu_fifo_t* f, void const * app_buf, uint16_t rel)
 {
-  memcpy(f->buffer + (rel * f->item_size), app_buf, f->item_size);
+  _ff_memcpy(f->buffer + (rel * f->item_size), app_buf, f->item_size);
 }
 
 // send n items to fifo WITHOUT updating write pointer
@@ -169,18 +201,18 @@ static void _ff_push_n(tu_fifo_t* f, void const * app_buf, uint16_t n, uint16_t
       if(n <= lin_count)
       {
         // Linear only
-        memcpy(ff_buf, app_buf, n*f->item_size);
+        _ff_memcpy(ff_buf, app_buf, n*f->item_size);
       }
       else
       {
         // Wrap around
 
         // Write data to linear part of buffer
-        memcpy(ff_buf, app_buf, lin_bytes);
+        _ff_memcpy(ff_buf, app_buf, lin_bytes);
 
         // Write data wrapped around
         // TU_ASSERT(nWrap_bytes <= f->depth, );
-        memcpy(f->buffer, ((uint8_t const*) app_buf) + lin_bytes, wrap_bytes);
+        _ff_memcpy(f->buffer, ((uint8_t const*) app_buf) + lin_bytes, wrap_bytes);
       }
       break;
 #ifdef TUP_MEM_CONST_ADDR
@@ -236,7 +268,7 @@ static void _ff_push_n(tu_fifo_t* f, void const * app_buf, uint16_t n, uint16_t
 // get one item from fifo WITHOUT updating read pointer
 static inline void _ff_pull(tu_fifo_t* f, void * app_buf, uint16_t rel)
 {
-  memcpy(app_buf, f->buffer + (rel * f->item_size), f->item_size);
+  _ff_memcpy(app_buf, f->buffer + (rel * f->item_size), f->item_size);
 }
 
 // get n items from fifo WITHOUT updating read pointer
@@ -257,17 +289,17 @@ static void _ff_pull_n(tu_fifo_t* f, void* app_buf, uint16_t n, uint16_t rd_ptr,
       if ( n <= lin_count )
       {
         // Linear only
-        memcpy(app_buf, ff_buf, n*f->item_size);
+        _ff_memcpy(app_buf, ff_buf, n*f->item_size);
       }
       else
       {
         // Wrap around
 
         // Read data from linear part of buffer
-        memcpy(app_buf, ff_buf, lin_bytes);
+        _ff_memcpy(app_buf, ff_buf, lin_bytes);
 
         // Read data wrapped part
-        memcpy((uint8_t*) app_buf + lin_bytes, f->buffer, wrap_bytes);
+        _ff_memcpy((uint8_t*) app_buf + lin_bytes, f->buffer, wrap_bytes);
       }
     break;
 #ifdef TUP_MEM_CONST_ADDR
@@ -329,6 +361,12 @@ static void _ff_pull_n(tu_fifo_t* f, void* app_buf, uint16_t n, uint16_t rd_ptr,
 TU_ATTR_ALWAYS_INLINE static inline
 uint16_t _ff_count(uint16_t depth, uint16_t wr_idx, uint16_t rd_idx)
 {
+  // Power of two depth: index space [0..2*depth) wraps with a mask
+  if (tu_is_power_of_two(depth))
+  {
+    return (uint16_t) ((wr_idx - rd_idx) & (2*depth - 1));
+  }
+
   // In case we have non-power of two depth we need a further modification
   if (wr_idx >= rd_idx)
   {
@@ -355,6 +393,11 @@ uint16_t _ff_remaining(uint16_t depth, uint16_t wr_idx, uint16_t rd_idx)
 // "absolute" index is only in the range of [0..2*depth)
 static uint16_t advance_index(uint16_t depth, uint16_t idx, uint16_t offset)
 {
+  if (tu_is_power_of_two(depth))
+  {
+    return (uint16_t) ((idx + offset) & (2*depth - 1));
+  }
+
   // We limit the index space of p such that a correct wrap around happens
   // Check for a wrap around or if we are in unused index space - This has to be checked first!!
   // We are exploiting the wrap around to the correct index
@@ -390,6 +433,11 @@ static uint16_t backward_index(uint16_t depth, uint16_t idx, uint16_t offset)
 TU_ATTR_ALWAYS_INLINE static inline
 uint16_t idx2ptr(uint16_t depth, uint16_t idx)
 {
+  if (tu_is_power_of_two(depth))
+  {
+    return idx & (depth - 1);
+  }
+
   // Only run at most 3 times since index is limit in the range of [0..2*depth)
   while ( idx >= depth ) idx -= depth;
   return idx;
@@ -543,6 +591,7 @@ static uint16_t _tu_fifo_write_n(tu_fifo_t* f, const void * data, uint16_t n, tu
     _ff_push_n(f, buf8, n, wr_ptr, copy_mode);
 
     // Advance index
+    _ff_barrier();
     f->wr_idx = advance_index(f->depth, wr_idx, n);
 
     TU_LOG(TU_FIFO_DBG, "\tnew_wr = %u\r\n", f->wr_idx);
@@ -562,6 +611,7 @@ static uint16_t _tu_fifo_read_n(tu_fifo_t* f, void * buffer, uint16_t n, tu_fifo
   n = _tu_fifo_peek_n(f, buffer, n, f->wr_idx, f->rd_idx, copy_mode);
 
   // Advance read pointer
+  _ff_barrier();
   f->rd_idx = advance_index(f->depth, f->rd_idx, n);
 
   _ff_unlock(f->mutex_rd);
@@ -705,6 +755,7 @@ bool tu_fifo_read(tu_fifo_t* f, void * buffer)
   bool ret = _tu_fifo_peek(f, buffer, f->wr_idx, f->rd_idx);
 
   // Advance pointer
+  _ff_barrier();
   f->rd_idx = advance_index(f->depth, f->rd_idx, ret);
 
   _ff_unlock(f->mutex_rd);
@@ -834,6 +885,7 @@ bool tu_fifo_write(tu_fifo_t* f, const void * data)
     _ff_push(f, data, wr_ptr);
 
     // Advance pointer
+    _ff_barrier();
     f->wr_idx = advance_index(f->depth, wr_idx, 1);
 
     ret = true;
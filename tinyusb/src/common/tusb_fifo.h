@@ -40,6 +40,10 @@ extern "C" {
 // Also, this FIFO is ready to be used in combination with a DMA as the write and
 // read pointers can be updated from within a DMA ISR. Overflows are detectable
 // within a certain number (see tu_fifo_overflow()).
+//
+// Power-of-two depths use masking instead of the generic modulo index logic,
+// and copies whose length is a multiple of 4 bytes (e.g. 4-byte USB-MIDI
+// packets) are moved word by word.
 
 #include "common/tusb_common.h"
 #include "osal/osal.h"
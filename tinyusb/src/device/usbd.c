@@ -228,7 +228,11 @@ tu_static usbd_class_driver_t const _usbd_driver[] = {
         .reset            = midid_reset,
         .control_xfer_cb  = midid_control_xfer_cb,
         .xfer_cb          = midid_xfer_cb,
+        #if CFG_TUD_MIDI_TX_SOF_SYNC
+        .sof              = midid_sof_isr
+        #else
         .sof              = NULL
+        #endif
     },
     #endif
 
@@ -295,6 +295,9 @@ static void edpt_disable(uint8_t rhport, uint8_t ep_addr, bool stall) {
       dep->diepint = DIEPINT_EPDISD;
     }
 
+    // The TXFE handler must not refill the FIFO of an aborted transfer
+    dwc2->diepempmsk &= ~(1 << epnum);
+
     // Flush the FIFO, and wait until we have confirmed it cleared.
     dfifo_flush_tx(dwc2, epnum);
   } else {
@@ -374,6 +377,19 @@ static void edpt_schedule_packets(uint8_t rhport, const uint8_t epnum, const uin
 
     // Enable tx fifo empty interrupt only if there is data. Note must after depctl enable
     if (dir == TUSB_DIR_IN && total_bytes != 0) {
+      #if CFG_TUD_DWC2_SLAVE_TX_PREFILL
+      // Single packet with enough room in the TX FIFO: push it now, TXFE stays masked so the ISR won't touch it
+      if (num_packets == 1 && total_bytes <= ((dep->dtxfsts & DTXFSTS_INEPTFSAV_Msk) << 2)) {
+        if (xfer->ff) {
+          volatile uint32_t* tx_fifo = dwc2->fifo[epnum];
+          tu_fifo_read_n_const_addr_full_words(xfer->ff, (void*)(uintptr_t)tx_fifo, total_bytes);
+        } else {
+          dfifo_write_packet(dwc2, epnum, xfer->buffer, total_bytes);
+          xfer->buffer += total_bytes;
+        }
+        return;
+      }
+      #endif
       dwc2->diepempmsk |= (1 << epnum);
     }
   }
@@ -591,6 +607,8 @@ bool dcd_edpt_xfer(uint8_t rhport, uint8_t ep_addr, uint8_t* buffer, uint16_t to
 bool dcd_edpt_xfer_fifo(uint8_t rhport, uint8_t ep_addr, tu_fifo_t* ff, uint16_t total_bytes) {
   // USB buffers always work in bytes so to avoid unnecessary divisions we demand item_size = 1
   TU_ASSERT(ff->item_size == 1);
+  // FIFO is drained by the TXFE/RXFLVL handlers, DMA mode has no such path
+  TU_ASSERT(!dma_device_enabled(DWC2_REG(rhport)));
 
   uint8_t const epnum = tu_edpt_number(ep_addr);
   uint8_t const dir = tu_edpt_dir(ep_addr);
@@ -930,14 +948,16 @@ static void handle_epin_dma(uint8_t rhport, uint8_t epnum, dwc2_diepint_t diepin
 static void handle_ep_irq(uint8_t rhport, uint8_t dir) {
   dwc2_regs_t* dwc2 = DWC2_REG(rhport);
   const bool is_dma = dma_device_enabled(dwc2);
-  const uint8_t ep_count = dwc2_ep_count(dwc2);
   const uint8_t daint_offset = (dir == TUSB_DIR_IN) ? DAINT_IEPINT_Pos : DAINT_OEPINT_Pos;
   dwc2_dep_t* ep_base = &dwc2->ep[dir == TUSB_DIR_IN ? 0 : 1][0];
 
   // DAINT for a given EP clears when DEPINTx is cleared.
   // EPINT will be cleared when DAINT bits are cleared.
-  for (uint8_t epnum = 0; epnum < ep_count; epnum++) {
-    if (dwc2->daint & TU_BIT(daint_offset + epnum)) {
+  // Snapshot DAINT once and stop after the highest pending endpoint: every register read is an AHB access.
+  // Endpoints raised while we are here keep GINTSTS set and re-enter the handler.
+  uint32_t daint = (dwc2->daint >> daint_offset) & 0xFFFFu;
+  for (uint8_t epnum = 0; daint != 0; epnum++, daint >>= 1) {
+    if (daint & 1u) {
       dwc2_dep_t* epout = &ep_base[epnum];
       union {
         uint32_t value;
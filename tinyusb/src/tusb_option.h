@@ -267,6 +267,12 @@
   #define CFG_TUD_DWC2_DMA_ENABLE CFG_TUD_DWC2_DMA_ENABLE_DEFAULT
 #endif
 
+// DWC2 Slave mode: write a single-packet IN transfer into the TX FIFO when it is queued instead of waiting
+// for the TX FIFO empty interrupt. Saves one interrupt per packet on cores without DMA.
+#ifndef CFG_TUD_DWC2_SLAVE_TX_PREFILL
+  #define CFG_TUD_DWC2_SLAVE_TX_PREFILL 0
+#endif
+
 // Enable DWC2 Slave mode for host
 #ifndef CFG_TUH_DWC2_SLAVE_ENABLE
   #ifndef CFG_TUH_DWC2_SLAVE_ENABLE_DEFAULT
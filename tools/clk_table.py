@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Clock-level table for POWER_GUIDE.md from the firmware's own measurements.
+
+The clock governor (Pedal_f411/clock_gov.cpp) logs every stay on a level, at most
+10 s long:
+
+    clk: stay level <n>, <ticks> ticks, <us> us awake
+
+ticks is the TIM5 time on the level (100 us; TIM5 stops in STOP), us the part of
+it outside WFI, counted with DWT CYCCNT. Feed this script the decoded log of a
+-DUSB_CDC_CONSOLE=ON build:
+
+    tools/diag_log.py build/Debug/midi_pedal_f411_tinyUSB_vscode.elf /dev/ttyACM0 | tee pedal.log
+    tools/clk_table.py pedal.log
+
+Time share and awake share are measured. The current column is not: it weights
+the datasheet estimates run_ma_x10 / sleep_ma_x10 of clk_levels[] (read from
+clock_gov.cpp) with the measured awake share.
+"""
+
+import argparse
+import os
+import re
+import sys
+
+TICK_S = 100e-6
+STAY = re.compile(r"clk: stay level (\d+), (\d+) ticks, (\d+) us awake")
+LEVEL_ROW = re.compile(r"\{\s*(\d+)u,\s*RCC_SYSCLK_DIV\d+,\s*FLASH_LATENCY_\d+,\s*0x[0-9a-fA-F]+u,\s*(\d+)u,\s*(\d+)u\s*\}")
+LEVEL_NAMES = ("active", "idle")
+CLOCK_GOV = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Pedal_f411", "clock_gov.cpp")
+
+
+def clk_levels(path):
+    """[(hclk_hz, run_ma, sleep_ma)] from the clk_levels[] initializer."""
+    with open(path, encoding="utf-8") as f:
+        src = f.read()
+    start = src.find("clk_levels[")
+    rows = LEVEL_ROW.findall(src, start, src.find("};", start))
+    if not rows:
+        sys.exit(f"{path}: no clk_levels[] initializer")
+    return [(int(hz), int(run) / 10, int(sleep) / 10) for hz, run, sleep in rows]
+
+
+def stays(lines):
+    """{level: [seconds, awake seconds]} summed over the 'clk: stay' lines."""
+    total = {}
+    for line in lines:
+        m = STAY.search(line)
+        if not m:
+            continue
+        level, ticks, awake_us = (int(g) for g in m.groups())
+        t = total.setdefault(level, [0.0, 0.0])
+        t[0] += ticks * TICK_S
+        t[1] += awake_us * 1e-6
+    return total
+
+
+def table(levels, total):
+    seconds = sum(t[0] for t in total.values())
+    if not seconds:
+        sys.exit("no 'clk: stay' records: decode the log of a -DUSB_CDC_CONSOLE=ON build")
+    out = [
+        f"Замер: {seconds:.0f} с работы (без STOP), `tools/clk_table.py`.",
+        "",
+        "| Уровень | HCLK | Доля времени | Вне WFI | Ток, оценка* |",
+        "|---------|------|--------------|---------|--------------|",
+    ]
+    average = 0.0
+    for i, (hz, run_ma, sleep_ma) in enumerate(levels):
+        t, awake = total.get(i, (0.0, 0.0))
+        duty = awake / t if t else 0.0
+        ma = duty * run_ma + (1.0 - duty) * sleep_ma
+        average += ma * t / seconds
+        name = LEVEL_NAMES[i] if i < len(LEVEL_NAMES) else str(i)
+        out.append(f"| {name} | {hz / 1e6:.0f} МГц | {100 * t / seconds:.1f} % | {100 * duty:.1f} % | ~{ma:.1f} мА |")
+    out += [
+        f"| среднее | | | | ~{average:.1f} мА |",
+        "",
+        "\\* Ток не замерен: оценки даташита `run_ma_x10` / `sleep_ma_x10`, взвешенные замеренной долей вне WFI.",
+    ]
+    return "\n".join(out)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("log", nargs="?", default="-", help="output of tools/diag_log.py, or '-' for stdin")
+    ap.add_argument("--clock-gov", default=CLOCK_GOV, help="clock_gov.cpp with clk_levels[]")
+    opts = ap.parse_args()
+
+    levels = clk_levels(opts.clock_gov)
+    if opts.log == "-":
+        total = stays(sys.stdin)
+    else:
+        with open(opts.log, encoding="utf-8", errors="replace") as f:
+            total = stays(f)
+    print(table(levels, total))
+
+
+if __name__ == "__main__":
+    main()
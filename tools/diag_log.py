@@ -0,0 +1,251 @@
+#!/usr/bin/env python3
+"""Decoder for the binary log (Pedal_f411/diag_log.hpp) and trace (Pedal_f411/trace.hpp).
+
+Reads the format strings from the ELF (sections .log_strings and .trace_strings,
+never loaded to flash) and renders the records arriving on the CDC console:
+
+    tools/diag_log.py build/Debug/midi_pedal_f411_tinyUSB_vscode.elf /dev/ttyACM0
+
+The source may be a serial device, a file with a captured dump, or '-' for stdin.
+Opening the tty raises DTR; the firmware starts draining its ring only then,
+so the first lines are the records buffered since boot.
+
+Trace records may also come over the other two drains:
+    --sysex   raw MIDI bytes of the diagnostic cable, F0 7D 03 <word: 5 x 7 bit, LSB first>... F7
+              (e.g. amidi -p hw:1,0,2 -r /dev/stdout | tools/diag_log.py --sysex fw.elf -)
+    --itm N   SWO byte stream from the probe; software packets of stimulus port N
+
+Record: little-endian 32-bit words
+    [0] bit 31 ready, [27:24] argument count, [23:0] string id (address in the section)
+    [1] timestamp: TIM5 100 us ticks for the log, DWT CYCCNT for the trace
+    [2..] arguments
+Each ring has its own "records lost" notice, the count as its argument: id 0 for
+the log (TIM5 stamp), id 0x800000 for the trace (CYCCNT stamp), one below the
+start of the ring's string table.
+Trace cycles are converted with --hclk until a "clk: hclk %u Hz" point reports the
+clock governor's switch.
+"""
+
+import argparse
+import os
+import re
+import struct
+import sys
+import termios
+import tty
+
+SECTIONS = (".log_strings", ".trace_strings")
+TRACE_SECTION = ".trace_strings"
+TICK_S = 100e-6
+SYSEX_TRACE = b"\xf0\x7d\x03"
+HCLK_POINT = "clk: hclk"
+HEAD_READY = 1 << 31
+LOST = {0x000000: SECTIONS[0], 0x800000: TRACE_SECTION}
+ARGS_MAX = 4
+
+SPEC = re.compile(r"%(%|[-+ 0#]*\d*[udixXc])")
+
+
+def elf_strings(path):
+    """{id: (section, format string)} from the string sections of a 32-bit little-endian ELF."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        sys.exit(f"{path}: not a 32-bit little-endian ELF")
+    e_shoff, = struct.unpack_from("<I", elf, 0x20)
+    e_shentsize, e_shnum, e_shstrndx = struct.unpack_from("<HHH", elf, 0x2E)
+
+    def shdr(i):
+        return struct.unpack_from("<IIIIIIIIII", elf, e_shoff + i * e_shentsize)
+
+    names_off = shdr(e_shstrndx)[4]
+    table = {}
+    for i in range(e_shnum):
+        name, _type, _flags, addr, offset, size = shdr(i)[:6]
+        end = elf.index(b"\0", names_off + name)
+        section = elf[names_off + name:end].decode()
+        if section not in SECTIONS:
+            continue
+        data = elf[offset:offset + size]
+        pos = 0
+        while pos < len(data):
+            nul = data.find(b"\0", pos)
+            if nul < 0:
+                nul = len(data)
+            if nul > pos:
+                table[addr + pos] = (section, data[pos:nul].decode("utf-8", "replace"))
+            pos = nul + 1
+    if not table:
+        sys.exit(f"{path}: no {' / '.join(SECTIONS)} section (build with -DUSB_CDC_CONSOLE=ON or -DISR_TRACE=ON)")
+    return table
+
+
+def render(fmt, args):
+    """printf-style subset: integers only; %d/%i take the argument as int32."""
+    it = iter(args)
+
+    def one(m):
+        spec = m.group(1)
+        if spec == "%":
+            return "%"
+        value = next(it, 0)
+        if spec[-1] in "di":
+            value = value - (1 << 32) if value & (1 << 31) else value
+            spec = spec[:-1] + "d"
+        elif spec[-1] == "u":
+            spec = spec[:-1] + "d"
+        elif spec[-1] == "c":
+            value = chr(value & 0xFF)
+        return ("%" + spec) % value
+
+    return SPEC.sub(one, fmt)
+
+
+def chunks(stream):
+    while True:
+        chunk = stream.read(256)
+        if not chunk:
+            return
+        yield chunk
+
+
+def sysex_words(source):
+    """Trace SysEx messages in a raw MIDI byte stream -> record bytes; everything else is skipped."""
+    buf = b""
+    for chunk in source:
+        buf += chunk
+        while True:
+            start = buf.find(SYSEX_TRACE)
+            if start < 0:
+                buf = buf[-(len(SYSEX_TRACE) - 1):]
+                break
+            end = buf.find(b"\xf7", start)
+            if end < 0:
+                buf = buf[start:]
+                break
+            body = buf[start + len(SYSEX_TRACE):end]
+            buf = buf[end + 1:]
+            words = []
+            for i in range(0, len(body) - 4, 5):
+                words.append(sum((body[i + k] & 0x7F) << (7 * k) for k in range(5)) & 0xFFFFFFFF)
+            yield struct.pack(f"<{len(words)}I", *words)
+
+
+def itm_port(source, port):
+    """ITM/SWO packets -> payload of the software packets of one stimulus port."""
+    sizes = {1: 1, 2: 2, 3: 4}
+    pending = b""
+    for chunk in source:
+        pending += chunk
+        out = bytearray()
+        pos = 0
+        while pos < len(pending):
+            head = pending[pos]
+            if head & 3:
+                size = sizes[head & 3]
+                if pos + 1 + size > len(pending):
+                    break
+                if not head & 4 and head >> 3 == port:
+                    out += pending[pos + 1:pos + 1 + size]
+                pos += 1 + size
+            elif head & 0x80 and head != 0x80:
+                # Timestamp or extension: payload bytes while the continuation bit is set
+                end = pos + 1
+                while end < len(pending) and pending[end] & 0x80:
+                    end += 1
+                if end >= len(pending):
+                    break
+                pos = end + 1
+            else:
+                pos += 1  # sync, overflow and one-byte timestamps
+        pending = pending[pos:]
+        if out:
+            yield bytes(out)
+
+
+def records(source, table):
+    """Words -> records. Resynchronizes one byte at a time on a header that does not check out."""
+    buf = b""
+    for chunk in source:
+        buf += chunk
+        while len(buf) >= 8:
+            head, = struct.unpack_from("<I", buf, 0)
+            nargs = (head >> 24) & 0x7F
+            sid = head & 0xFFFFFF
+            if not head & HEAD_READY or nargs > ARGS_MAX or (sid not in LOST and sid not in table):
+                buf = buf[1:]
+                continue
+            n = 4 * (2 + nargs)
+            if len(buf) < n:
+                break
+            words = struct.unpack_from(f"<{2 + nargs}I", buf, 0)
+            buf = buf[n:]
+            yield sid, words[1], words[2:]
+
+
+def open_source(name):
+    if name == "-":
+        return sys.stdin.buffer
+    fd = os.open(name, os.O_RDONLY | os.O_NOCTTY)
+    if os.isatty(fd):
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        attrs[2] |= termios.HUPCL  # DTR is dropped on close: the firmware stops draining
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+    return os.fdopen(fd, "rb", buffering=0)
+
+
+class TraceClock:
+    """CYCCNT -> microseconds since the first trace record. Keeps up with wraps and HCLK switches."""
+
+    def __init__(self, hclk):
+        self.hclk = hclk
+        self.last = None
+        self.us = 0.0
+
+    def step(self, cycles):
+        delta = 0 if self.last is None else (cycles - self.last) & 0xFFFFFFFF
+        self.last = cycles
+        self.us += delta * 1e6 / self.hclk
+        return delta
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf", help="firmware ELF of the running build")
+    ap.add_argument("source", nargs="?", default="/dev/ttyACM0", help="tty, capture file or '-'")
+    mode = ap.add_mutually_exclusive_group()
+    mode.add_argument("--sysex", action="store_true", help="source is raw MIDI of the diagnostic cable")
+    mode.add_argument("--itm", type=int, metavar="PORT", help="source is SWO; take stimulus port PORT (1)")
+    ap.add_argument("--hclk", type=float, default=96e6, help="HCLK at boot, Hz (96e6)")
+    opts = ap.parse_args()
+
+    table = elf_strings(opts.elf)
+    clock = TraceClock(opts.hclk)
+    source = chunks(open_source(opts.source))
+    if opts.sysex:
+        source = sysex_words(source)
+    elif opts.itm is not None:
+        source = itm_port(source, opts.itm)
+    try:
+        for sid, stamp, args in records(source, table):
+            if sid in LOST:
+                section = LOST[sid]
+                kind = "trace" if section == TRACE_SECTION else "log"
+                text = f"<{args[0] if args else 0} {kind} records lost>"
+            else:
+                section, fmt = table[sid]
+                text = render(fmt, args)
+            if section != TRACE_SECTION:
+                print(f"[{stamp * TICK_S:12.4f}] {text}", flush=True)
+                continue
+            delta = clock.step(stamp)
+            print(f"<{clock.us:12.1f} us +{delta:8d}> {text}", flush=True)
+            if sid not in LOST and fmt.startswith(HCLK_POINT) and args and args[0]:
+                clock.hclk = args[0]
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()